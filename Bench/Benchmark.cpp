@@ -0,0 +1,656 @@
+// Loader/Renderer Benchmark //
+/*
+Separate program with its own main (build the .cpp files in Bench/ with the viewer's libraries,
+not together with the viewer's Source.cpp) that generates synthetic scenes and times how
+Model::loadModel, processMesh, Mesh::setupMesh and Model::Draw scale with them.
+
+Every scenario is written once as a model file with Assimp's exporter, then loaded repeatedly:
+parse    - Assimp reading the file
+convert  - processNode/processMesh copying into Vertex/index lists + texture decoding
+upload   - Model::Upload (setupMesh + texture creation) until the GPU has finished
+draw     - Model::Draw submission time and full frame time (glFinish) per frame
+memory   - CPU/GPU bytes from MemoryTracker once uploaded
+
+Results are written as JSON (one result per line so they diff well between commits).
+Given a baseline file from an earlier run, any metric that got worse by more than the
+threshold makes the program exit with 1.
+
+Runs without a GPU under Mesa's llvmpipe, e.g.
+LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a ./EPQBench --suite quick --baseline old.json
+*/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+// GLEW //
+#define GLEW_STATIC
+#include <GL/glew.h>
+// GLFW //
+#include <GLFW/glfw3.h>
+// GLM //
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+// Assimp (scene generation) //
+#include <assimp/Exporter.hpp>
+// Other includes //
+#include "../Source/Shader.h"
+#include "../Source/Model.h"
+#include "../Source/ImageWriter.h"
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+//One synthetic scene
+struct Scenario
+{
+	std::string name;
+	int triangles;	//Total over all sub-meshes
+	int meshes;		//Number of sub-meshes
+	int textures;	//Distinct diffuse textures (at most one per sub-mesh)
+	bool deep;		//Node tree: deep = chain with one mesh per level, flat = one child per mesh under the root
+};
+
+struct BenchSettings
+{
+	std::vector<Scenario> scenarios;
+	std::string suite = "quick";
+	int repeat = 3;
+	int frames = 50;
+	int width = 256, height = 256;
+	int textureSize = 64;
+	std::string workDir = "bench_scenes";
+	std::string format = "collada"; //Any Assimp export format id
+	std::string output = "bench_results.json";
+	std::string baseline;
+	double threshold = 10.0; //Percent
+	double minMs = 0.5; //Time differences below this are noise
+	std::string renderer; //GL_RENDERER, so results from different machines aren't mixed up
+};
+
+//Metrics written for every scenario, in output order
+static const char* metricNames[] = { "parse_ms", "convert_ms", "upload_ms", "draw_submit_ms", "draw_frame_ms", "cpu_bytes", "gpu_bytes", "cpu_peak_bytes" };
+static const int metricCount = sizeof(metricNames) / sizeof(metricNames[0]);
+
+struct Result
+{
+	Scenario scenario;
+	double metrics[metricCount];
+};
+
+//Function Prototypes
+bool parse_args(int argc, char* argv[], BenchSettings& settings);
+std::vector<Scenario> make_suite(const std::string& suite);
+bool generate_scene(const Scenario& scenario, const BenchSettings& settings, const std::string& path);
+bool run_scenario(const Scenario& scenario, const BenchSettings& settings, Shader& shader, Result& result);
+std::vector<std::pair<std::string, std::string> > header_fields(const BenchSettings& settings);
+void write_results(std::ostream& out, const BenchSettings& settings, const std::vector<Result>& results);
+int compare_baseline(const BenchSettings& settings, const std::vector<Result>& results);
+
+int main(int argc, char* argv[])
+{
+	BenchSettings settings;
+	if (!parse_args(argc, argv, settings))
+		return -1;
+	if (settings.scenarios.empty())
+		settings.scenarios = make_suite(settings.suite);
+	if (settings.scenarios.empty())
+	{
+		std::cout << "ERROR::BENCH::UNKNOWN_SUITE::" << settings.suite << std::endl;
+		return -1;
+	}
+
+	// Hidden window, only the context is needed //
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	GLFWwindow* window = glfwCreateWindow(settings.width, settings.height, "EPQ Benchmark", nullptr, nullptr);
+	if (window == nullptr)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+
+	glewExperimental = GL_TRUE;
+	if (glewInit() != GLEW_OK)
+	{
+		std::cout << "Failed to initialise GLEW" << std::endl;
+		return -1;
+	}
+	glViewport(0, 0, settings.width, settings.height);
+	glEnable(GL_DEPTH_TEST);
+	settings.renderer = (const char*)glGetString(GL_RENDERER);
+	std::cout << "Renderer: " << settings.renderer << std::endl;
+
+	Shader shader("vertex.txt", "fragment.txt");
+
+#ifdef _WIN32
+	_mkdir(settings.workDir.c_str());
+#else
+	mkdir(settings.workDir.c_str(), 0755);
+#endif
+
+	std::vector<Result> results;
+	for (size_t i = 0; i < settings.scenarios.size(); i++)
+	{
+		Result result;
+		if (!run_scenario(settings.scenarios[i], settings, shader, result))
+		{
+			glfwTerminate();
+			return -1;
+		}
+		results.push_back(result);
+	}
+	glfwTerminate();
+
+	std::ofstream file(settings.output.c_str());
+	if (!file)
+	{
+		std::cout << "ERROR::BENCH::COULD_NOT_WRITE::" << settings.output << std::endl;
+		return -1;
+	}
+	write_results(file, settings, results);
+	std::cout << "Results written to " << settings.output << std::endl;
+
+	if (!settings.baseline.empty())
+		return compare_baseline(settings, results);
+	return 0;
+}
+
+
+
+// Scenarios //
+/*
+quick - small enough for every commit on a software renderer
+full  - the whole range: up to 1M triangles, 10k sub-meshes, 1k textures
+*/
+std::vector<Scenario> make_suite(const std::string& suite)
+{
+	std::vector<Scenario> scenarios;
+	if (suite != "quick" && suite != "full")
+		return scenarios;
+
+	Scenario quick[] = {
+		{ "triangles_1", 1, 1, 0, false },
+		{ "triangles_10k", 10000, 1, 0, false },
+		{ "meshes_100_flat", 10000, 100, 0, false },
+		{ "meshes_100_deep", 10000, 100, 0, true },
+		{ "textures_10", 1000, 10, 10, false },
+	};
+	scenarios.assign(quick, quick + sizeof(quick) / sizeof(quick[0]));
+
+	if (suite == "full")
+	{
+		Scenario full[] = {
+			{ "triangles_100k", 100000, 1, 0, false },
+			{ "triangles_1m", 1000000, 1, 0, false },
+			{ "meshes_1k_flat", 100000, 1000, 0, false },
+			{ "meshes_1k_deep", 100000, 1000, 0, true },
+			{ "meshes_10k_flat", 100000, 10000, 0, false },
+			{ "meshes_10k_deep", 100000, 10000, 0, true },
+			{ "textures_100", 10000, 100, 100, false },
+			{ "textures_1k", 10000, 1000, 1000, false },
+		};
+		scenarios.insert(scenarios.end(), full, full + sizeof(full) / sizeof(full[0]));
+	}
+	return scenarios;
+}
+
+// Scene Generation //
+
+//Flat grid of exactly `triangles` triangles in the unit square
+aiMesh* make_grid(int triangles, unsigned int material)
+{
+	int quads = (triangles + 1) / 2;
+	int cols = (int)ceil(sqrt((double)quads));
+	int rows = (quads + cols - 1) / cols;
+
+	aiMesh* mesh = new aiMesh();
+	mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+	mesh->mMaterialIndex = material;
+	mesh->mNumVertices = (rows + 1) * (cols + 1);
+	mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+	mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+	mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+	mesh->mNumUVComponents[0] = 2;
+	for (int r = 0; r <= rows; r++)
+		for (int c = 0; c <= cols; c++)
+		{
+			int v = r * (cols + 1) + c;
+			mesh->mVertices[v] = aiVector3D((float)c / cols, (float)r / rows, 0.0f);
+			mesh->mNormals[v] = aiVector3D(0.0f, 0.0f, 1.0f);
+			mesh->mTextureCoords[0][v] = aiVector3D((float)c / cols, (float)r / rows, 0.0f);
+		}
+
+	mesh->mNumFaces = triangles;
+	mesh->mFaces = new aiFace[triangles];
+	for (int t = 0; t < triangles; t++)
+	{
+		int quad = t / 2;
+		unsigned int corner = (quad / cols) * (cols + 1) + quad % cols; //Bottom left vertex of the quad
+		aiFace& face = mesh->mFaces[t];
+		face.mNumIndices = 3;
+		face.mIndices = new unsigned int[3];
+		face.mIndices[0] = corner;
+		face.mIndices[1] = t % 2 == 0 ? corner + 1 : corner + cols + 2;
+		face.mIndices[2] = t % 2 == 0 ? corner + cols + 2 : corner + cols + 1;
+	}
+	return mesh;
+}
+
+std::string texture_name(const BenchSettings& settings, int index)
+{
+	std::stringstream ss;
+	ss << "texture_" << settings.textureSize << "_" << index << ".png";
+	return ss.str();
+}
+
+std::string extension_for(const std::string& format)
+{
+	if (format == "collada")
+		return "dae";
+	if (format == "gltf2")
+		return "gltf";
+	if (format == "glb2")
+		return "glb";
+	return format; //obj, ply, stl, assbin, ...
+}
+
+bool file_exists(const std::string& path)
+{
+	std::ifstream file(path.c_str());
+	return file.good();
+}
+
+//Writes the scenario's model (and any textures it needs) with Assimp's exporter
+bool generate_scene(const Scenario& scenario, const BenchSettings& settings, const std::string& path)
+{
+	// Textures //
+	for (int i = 0; i < scenario.textures; i++)
+	{
+		std::string texturePath = settings.workDir + "/" + texture_name(settings, i);
+		if (file_exists(texturePath))
+			continue;
+		std::vector<unsigned char> pixels((size_t)settings.textureSize * settings.textureSize * 4);
+		for (size_t p = 0; p < pixels.size(); p += 4)
+		{
+			pixels[p] = (unsigned char)(i * 37);
+			pixels[p + 1] = (unsigned char)(i * 91);
+			pixels[p + 2] = (unsigned char)(p / 4);
+			pixels[p + 3] = 255;
+		}
+		if (!ImageWriter::WritePNG(texturePath, settings.textureSize, settings.textureSize, &pixels[0]))
+			return false;
+	}
+
+	aiScene scene; //Frees everything attached to it when it goes out of scope
+
+	// Materials (one per texture, or one plain one) //
+	scene.mNumMaterials = scenario.textures > 0 ? scenario.textures : 1;
+	scene.mMaterials = new aiMaterial*[scene.mNumMaterials];
+	for (unsigned int i = 0; i < scene.mNumMaterials; i++)
+	{
+		scene.mMaterials[i] = new aiMaterial();
+		if (scenario.textures > 0)
+		{
+			aiString file(texture_name(settings, i));
+			scene.mMaterials[i]->AddProperty(&file, AI_MATKEY_TEXTURE_DIFFUSE(0));
+		}
+	}
+
+	// Meshes (triangles split evenly, remainder goes to the first ones) //
+	scene.mNumMeshes = scenario.meshes;
+	scene.mMeshes = new aiMesh*[scenario.meshes];
+	for (int i = 0; i < scenario.meshes; i++)
+	{
+		int triangles = scenario.triangles / scenario.meshes + (i < scenario.triangles % scenario.meshes ? 1 : 0);
+		scene.mMeshes[i] = make_grid(triangles, i % scene.mNumMaterials);
+	}
+
+	// Node Tree //
+	scene.mRootNode = new aiNode();
+	scene.mRootNode->mName.Set("root");
+	aiNode* parent = scene.mRootNode;
+	if (!scenario.deep)
+	{
+		parent->mNumChildren = scenario.meshes;
+		parent->mChildren = new aiNode*[scenario.meshes];
+	}
+	for (int i = 0; i < scenario.meshes; i++)
+	{
+		aiNode* node = new aiNode();
+		std::stringstream name;
+		name << "node_" << i;
+		node->mName.Set(name.str());
+		node->mNumMeshes = 1;
+		node->mMeshes = new unsigned int[1];
+		node->mMeshes[0] = i;
+		node->mParent = parent;
+		if (scenario.deep)
+		{
+			//Chain: each node is the only child of the previous one
+			parent->mNumChildren = 1;
+			parent->mChildren = new aiNode*[1];
+			parent->mChildren[0] = node;
+			parent = node;
+		}
+		else
+			parent->mChildren[i] = node;
+	}
+
+	Assimp::Exporter exporter;
+	if (exporter.Export(&scene, settings.format, path) != AI_SUCCESS)
+	{
+		std::cout << "ERROR::BENCH::EXPORT_FAILED::" << path << "::" << exporter.GetErrorString() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Measuring //
+double median(std::vector<double> values)
+{
+	if (values.empty())
+		return 0.0;
+	std::sort(values.begin(), values.end());
+	size_t middle = values.size() / 2;
+	return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+double ms_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Loads, draws and releases the scenario's model settings.repeat times, keeps the median of each metric
+bool run_scenario(const Scenario& scenario, const BenchSettings& settings, Shader& shader, Result& result)
+{
+	Scenario clamped = scenario;
+	clamped.meshes = std::max(1, std::min(scenario.meshes, scenario.triangles));
+	clamped.textures = std::max(0, std::min(scenario.textures, clamped.meshes));
+
+	std::stringstream file;
+	//Everything the generated file depends on is in its name, so a cached file is never reused for other settings
+	file << settings.workDir << "/" << clamped.triangles << "_" << clamped.meshes << "_" << clamped.textures
+		<< "x" << settings.textureSize << (clamped.deep ? "_deep." : "_flat.") << extension_for(settings.format);
+	std::string path = file.str();
+	if (!file_exists(path) && !generate_scene(clamped, settings, path))
+		return false;
+
+	std::cout << scenario.name << " (" << clamped.triangles << " triangles, " << clamped.meshes << " meshes, "
+		<< clamped.textures << " textures, " << (clamped.deep ? "deep" : "flat") << ")" << std::endl;
+
+	std::vector<double> samples[metricCount];
+	for (int run = 0; run < settings.repeat; run++)
+	{
+		std::unique_ptr<Model> model(new Model());
+		if (!model->Import(path))
+			return false;
+
+		std::chrono::steady_clock::time_point uploadStart = std::chrono::steady_clock::now();
+		model->Upload();
+		glFinish();
+		double uploadMs = ms_since(uploadStart);
+
+		MemorySnapshot memory = MemoryTracker::Get().Snapshot();
+		const OwnerMemory& owner = memory.owners[path];
+
+		// Draw //
+		glm::mat4 view = glm::lookAt(glm::vec3(0.5f, 0.5f, 2.0f), glm::vec3(0.5f, 0.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (GLfloat)settings.width / (GLfloat)settings.height, 0.1f, 100.0f);
+		glm::mat4 modelMatrix;
+		shader.Use();
+		glUniformMatrix4fv(glGetUniformLocation(shader.Program, "model"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
+		glUniformMatrix4fv(glGetUniformLocation(shader.Program, "view"), 1, GL_FALSE, glm::value_ptr(view));
+		glUniformMatrix4fv(glGetUniformLocation(shader.Program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+		std::vector<double> submit, frame;
+		for (int f = 0; f < settings.frames; f++)
+		{
+			std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			model->Draw(shader);
+			submit.push_back(ms_since(frameStart));
+			glFinish();
+			frame.push_back(ms_since(frameStart));
+		}
+
+		double values[metricCount] = {
+			model->LoadStats().parseMs, model->LoadStats().convertMs, uploadMs, median(submit), median(frame),
+			(double)owner.side[MEMORY_CPU].live, (double)owner.side[MEMORY_GPU].live, (double)owner.side[MEMORY_CPU].peak
+		};
+		for (int m = 0; m < metricCount; m++)
+			samples[m].push_back(values[m]);
+
+		model->Release();
+	}
+
+	result.scenario = clamped;
+	result.scenario.name = scenario.name;
+	for (int m = 0; m < metricCount; m++)
+		result.metrics[m] = median(samples[m]);
+	return true;
+}
+
+// Output //
+//Settings every result depends on, as JSON key/value pairs - results are only comparable if all of them match
+std::vector<std::pair<std::string, std::string> > header_fields(const BenchSettings& settings)
+{
+	std::vector<std::pair<std::string, std::string> > fields;
+	fields.push_back(std::make_pair("renderer", "\"" + settings.renderer + "\""));
+	fields.push_back(std::make_pair("format", "\"" + settings.format + "\""));
+	std::stringstream size;
+	size << "\"" << settings.width << "x" << settings.height << "\"";
+	fields.push_back(std::make_pair("size", size.str()));
+	fields.push_back(std::make_pair("texture_size", std::to_string(settings.textureSize)));
+	fields.push_back(std::make_pair("repeat", std::to_string(settings.repeat)));
+	fields.push_back(std::make_pair("frames", std::to_string(settings.frames)));
+	return fields;
+}
+
+void write_results(std::ostream& out, const BenchSettings& settings, const std::vector<Result>& results)
+{
+	out << "{\n";
+	std::vector<std::pair<std::string, std::string> > fields = header_fields(settings);
+	for (size_t i = 0; i < fields.size(); i++)
+		out << "  \"" << fields[i].first << "\": " << fields[i].second << ",\n";
+	out << "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result& result = results[i];
+		out << "    { \"scenario\": \"" << result.scenario.name << "\", \"triangles\": " << result.scenario.triangles
+			<< ", \"meshes\": " << result.scenario.meshes << ", \"textures\": " << result.scenario.textures
+			<< ", \"tree\": \"" << (result.scenario.deep ? "deep" : "flat") << "\"";
+		for (int m = 0; m < metricCount; m++)
+		{
+			out << ", \"" << metricNames[m] << "\": ";
+			if (std::string(metricNames[m]).find("_bytes") != std::string::npos)
+				out << (unsigned long long)result.metrics[m];
+			else
+				out << std::fixed << std::setprecision(3) << result.metrics[m];
+		}
+		out << (i + 1 < results.size() ? " },\n" : " }\n");
+	}
+	out << "  ]\n}\n";
+}
+
+// Baseline Comparison //
+/*
+Reads the per scenario lines of an earlier results file and compares every metric.
+A metric regresses when it is more than threshold percent higher than before
+(times also have to differ by more than minMs, so tiny timings don't flap).
+Baselines recorded with different settings (see header_fields) are refused, their numbers aren't comparable.
+Returns the exit code: 0 = fine, 1 = regressions, -1 = baseline unreadable or not comparable.
+*/
+int compare_baseline(const BenchSettings& settings, const std::vector<Result>& results)
+{
+	std::ifstream file(settings.baseline.c_str());
+	if (!file)
+	{
+		std::cout << "ERROR::BENCH::COULD_NOT_OPEN_BASELINE::" << settings.baseline << std::endl;
+		return -1;
+	}
+
+	std::map<std::string, std::map<std::string, double> > baseline;
+	std::map<std::string, std::string> header;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		//Header lines look like '  "key": value,'
+		if (line.find("  \"") == 0 && line.find("\": ") != std::string::npos && line.find("\"results\"") == std::string::npos)
+		{
+			size_t colon = line.find("\": ");
+			size_t end = line.find_last_not_of(",\r");
+			header[line.substr(3, colon - 3)] = line.substr(colon + 3, end + 1 - (colon + 3));
+			continue;
+		}
+
+		size_t start = line.find("\"scenario\": \"");
+		if (start == std::string::npos)
+			continue;
+		start += 13;
+		std::string scenario = line.substr(start, line.find('"', start) - start);
+		for (int m = 0; m < metricCount; m++)
+		{
+			std::string key = std::string("\"") + metricNames[m] + "\": ";
+			size_t at = line.find(key);
+			if (at != std::string::npos)
+				baseline[scenario][metricNames[m]] = atof(line.c_str() + at + key.size());
+		}
+	}
+
+	std::vector<std::pair<std::string, std::string> > fields = header_fields(settings);
+	bool comparable = true;
+	for (size_t i = 0; i < fields.size(); i++)
+	{
+		std::map<std::string, std::string>::iterator recorded = header.find(fields[i].first);
+		std::string before = recorded != header.end() ? recorded->second : "(missing)";
+		if (before != fields[i].second)
+		{
+			std::cout << "ERROR::BENCH::BASELINE_NOT_COMPARABLE::" << fields[i].first << " " << before << " in "
+				<< settings.baseline << ", " << fields[i].second << " in this run" << std::endl;
+			comparable = false;
+		}
+	}
+	if (!comparable)
+		return -1;
+
+	int regressions = 0;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		std::map<std::string, std::map<std::string, double> >::iterator old = baseline.find(results[i].scenario.name);
+		if (old == baseline.end())
+			continue; //New scenario, nothing to compare with
+		for (int m = 0; m < metricCount; m++)
+		{
+			std::map<std::string, double>::iterator before = old->second.find(metricNames[m]);
+			if (before == old->second.end())
+				continue;
+			double now = results[i].metrics[m];
+			bool isTime = std::string(metricNames[m]).find("_ms") != std::string::npos;
+			if (isTime && now - before->second <= settings.minMs)
+				continue;
+			if (now > before->second * (1.0 + settings.threshold / 100.0))
+			{
+				std::cout << "REGRESSION::" << results[i].scenario.name << "::" << metricNames[m] << " "
+					<< before->second << " -> " << now;
+				if (before->second > 0.0)
+					std::cout << " (+" << (now / before->second - 1.0) * 100.0 << "%)";
+				std::cout << std::endl;
+				regressions++;
+			}
+		}
+	}
+	if (regressions > 0)
+	{
+		std::cout << regressions << " regression(s) beyond " << settings.threshold << "%" << std::endl;
+		return 1;
+	}
+	std::cout << "No regressions beyond " << settings.threshold << "% against " << settings.baseline << std::endl;
+	return 0;
+}
+
+// Command Line Arguments //
+/*
+EPQBench [--suite quick|full] [--scenario name:triangles:meshes:textures:flat|deep]...
+         [--repeat 3] [--frames 50] [--size 256x256] [--texture-size 64] [--work bench_scenes]
+         [--format collada] [--out bench_results.json] [--baseline old.json] [--threshold 10] [--min-ms 0.5]
+--scenario can be given several times and replaces the suite.
+*/
+bool parse_args(int argc, char* argv[], BenchSettings& settings)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		bool ok = true;
+		if (arg == "--suite" && hasValue)
+			settings.suite = argv[++i];
+		else if (arg == "--scenario" && hasValue)
+		{
+			std::string spec = argv[++i];
+			std::replace(spec.begin(), spec.end(), ':', ' ');
+			std::stringstream ss(spec);
+			Scenario scenario;
+			std::string tree;
+			ss >> scenario.name >> scenario.triangles >> scenario.meshes >> scenario.textures >> tree;
+			scenario.deep = tree == "deep";
+			ok = !ss.fail() && scenario.triangles > 0 && scenario.meshes > 0 && scenario.textures >= 0 && (tree == "flat" || tree == "deep");
+			if (ok)
+				settings.scenarios.push_back(scenario);
+		}
+		else if (arg == "--repeat" && hasValue)
+			ok = (settings.repeat = atoi(argv[++i])) > 0;
+		else if (arg == "--frames" && hasValue)
+			ok = (settings.frames = atoi(argv[++i])) > 0;
+		else if (arg == "--size" && hasValue)
+		{
+			std::stringstream size(argv[++i]);
+			char x = 0;
+			size >> settings.width >> x >> settings.height;
+			ok = !size.fail() && x == 'x' && settings.width > 0 && settings.height > 0;
+		}
+		else if (arg == "--texture-size" && hasValue)
+			ok = (settings.textureSize = atoi(argv[++i])) > 0;
+		else if (arg == "--work" && hasValue)
+			settings.workDir = argv[++i];
+		else if (arg == "--format" && hasValue)
+			settings.format = argv[++i];
+		else if (arg == "--out" && hasValue)
+			settings.output = argv[++i];
+		else if (arg == "--baseline" && hasValue)
+			settings.baseline = argv[++i];
+		else if (arg == "--threshold" && hasValue)
+			ok = (settings.threshold = atof(argv[++i])) >= 0.0;
+		else if (arg == "--min-ms" && hasValue)
+			ok = (settings.minMs = atof(argv[++i])) >= 0.0;
+		else
+			ok = false;
+
+		if (!ok)
+		{
+			std::cout << "ERROR::ARGS::BAD_ARGUMENT::" << argv[i] << std::endl;
+			std::cout << "Usage: EPQBench [--suite quick|full] [--scenario name:triangles:meshes:textures:flat|deep]..." << std::endl;
+			std::cout << "                [--repeat 3] [--frames 50] [--size 256x256] [--texture-size 64] [--work bench_scenes]" << std::endl;
+			std::cout << "                [--format collada] [--out bench_results.json] [--baseline old.json] [--threshold 10] [--min-ms 0.5]" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,233 @@
+// Scene Loader Cancel Check //
+/*
+Separate program with its own main (build the .cpp files in Check/ with the viewer's libraries,
+not together with the viewer's Source.cpp) that cancels a SceneLoader entry in each state it can
+be caught in - queued, importing, imported, uploading, fenced and ready - and checks that it ends
+up cancelled with all of its CPU and GPU memory released again.
+
+Writes a generated OBJ file to the working directory and deletes it afterwards.
+Prints one line per state and exits with 0 if all of them passed, -1 otherwise.
+Runs without a GPU under Mesa's llvmpipe, e.g. LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -a ./EPQCheck
+*/
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <thread>
+#include <chrono>
+// GLEW //
+#define GLEW_STATIC
+#include <GL/glew.h>
+// GLFW //
+#include <GLFW/glfw3.h>
+// GLM //
+#include <glm/glm.hpp>
+// Other includes //
+#include "../Source/MemoryTracker.h"
+#include "../Source/SceneLoader.h"
+
+const char* const MODEL_PATH = "check_cancel.obj";
+const int MESHES = 8; //Several meshes so an upload can be stopped halfway
+const int GRID = 160; //Quads per side of each mesh, large enough that the import takes a while
+const int ATTEMPTS = 5; //Tries at catching a state that may pass before it is seen (importing)
+const double TIMEOUT_SECONDS = 30.0;
+
+//How getting an entry into a state went
+enum Reached
+{
+	REACHED,
+	MISSED,		//Went past the state between two polls, worth another try
+	TIMED_OUT
+};
+
+//Function Prototypes
+bool write_model();
+bool check(const char* name, SceneLoader::AssetState state);
+
+int main()
+{
+	// Hidden window, only the context is needed //
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	GLFWwindow* window = glfwCreateWindow(64, 64, "EPQ Check", nullptr, nullptr);
+	if (window == nullptr)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+
+	glewExperimental = GL_TRUE;
+	if (glewInit() != GLEW_OK)
+	{
+		std::cout << "Failed to initialise GLEW" << std::endl;
+		return -1;
+	}
+
+	if (!write_model())
+	{
+		glfwTerminate();
+		return -1;
+	}
+	bool passed = check("QUEUED", SceneLoader::ASSET_QUEUED);
+	passed = check("IMPORTING", SceneLoader::ASSET_IMPORTING) && passed;
+	passed = check("IMPORTED", SceneLoader::ASSET_IMPORTED) && passed;
+	passed = check("UPLOADING", SceneLoader::ASSET_UPLOADING) && passed;
+	passed = check("FENCED", SceneLoader::ASSET_FENCED) && passed;
+	passed = check("READY", SceneLoader::ASSET_READY) && passed;
+	std::remove(MODEL_PATH);
+
+	glfwTerminate();
+	return passed ? 0 : -1;
+}
+
+//Writes MESHES separate grid objects sharing one normal
+bool write_model()
+{
+	std::ofstream file(MODEL_PATH);
+	if (!file)
+	{
+		std::cout << "ERROR::CHECK::COULD_NOT_WRITE::" << MODEL_PATH << std::endl;
+		return false;
+	}
+	file << "vn 0 0 1\n";
+	int base = 1; //OBJ indices start at 1
+	for (int m = 0; m < MESHES; m++)
+	{
+		file << "o mesh" << m << "\n";
+		for (int y = 0; y <= GRID; y++)
+			for (int x = 0; x <= GRID; x++)
+				file << "v " << x / (float)GRID << " " << y / (float)GRID << " " << m << "\n";
+		for (int y = 0; y < GRID; y++)
+			for (int x = 0; x < GRID; x++)
+			{
+				int corner = base + y * (GRID + 1) + x;
+				file << "f " << corner << "//1 " << corner + 1 << "//1 " << corner + GRID + 2 << "//1 " << corner + GRID + 1 << "//1\n";
+			}
+		base += (GRID + 1) * (GRID + 1);
+	}
+	return file.good();
+}
+
+size_t live_bytes(MemorySide side)
+{
+	return MemoryTracker::Get().Snapshot().total[side].live;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Calls Update with the given budget until the entry reaches state
+bool update_until(SceneLoader& scene, size_t entry, SceneLoader::AssetState state, const UploadBudget& budget)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (seconds_since(start) < TIMEOUT_SECONDS)
+	{
+		scene.Update(glm::vec3(0.0f), budget);
+		if (scene.EntryState(entry) == state)
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return false;
+}
+
+//Drives a freshly added entry into state
+Reached reach(SceneLoader& scene, size_t entry, SceneLoader::AssetState state)
+{
+	UploadBudget none, oneStep, unlimited;
+	none.bytes = 0;
+	oneStep.bytes = 1; //Every step uploads at least one mesh
+	unlimited.bytes = (size_t)-1;
+	unlimited.milliseconds = 1000.0;
+
+	switch (state)
+	{
+	case SceneLoader::ASSET_QUEUED:
+		return scene.EntryState(entry) == state ? REACHED : MISSED; //Import threads only start in the first Update
+	case SceneLoader::ASSET_IMPORTING:
+	{
+		scene.Update(glm::vec3(0.0f), none);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		while (seconds_since(start) < TIMEOUT_SECONDS)
+		{
+			SceneLoader::AssetState now = scene.EntryState(entry);
+			if (now == state)
+				return REACHED;
+			if (now != SceneLoader::ASSET_QUEUED)
+				return MISSED;
+			std::this_thread::yield();
+		}
+		return TIMED_OUT;
+	}
+	case SceneLoader::ASSET_IMPORTED:
+		return update_until(scene, entry, state, none) ? REACHED : TIMED_OUT;
+	case SceneLoader::ASSET_UPLOADING:
+	case SceneLoader::ASSET_FENCED:
+		//One step of a single mesh leaves it uploading, an unlimited one submits everything and inserts the fence
+		if (!update_until(scene, entry, SceneLoader::ASSET_IMPORTED, none))
+			return TIMED_OUT;
+		scene.Update(glm::vec3(0.0f), state == SceneLoader::ASSET_UPLOADING ? oneStep : unlimited);
+		return scene.EntryState(entry) == state ? REACHED : MISSED;
+	default:
+		return update_until(scene, entry, state, unlimited) ? REACHED : TIMED_OUT;
+	}
+}
+
+//Waits for the cancelled model's memory to be released (a running import drops it when it stops)
+bool released(SceneLoader& scene, size_t cpuBefore, size_t gpuBefore)
+{
+	UploadBudget none;
+	none.bytes = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (seconds_since(start) < TIMEOUT_SECONDS)
+	{
+		scene.Update(glm::vec3(0.0f), none);
+		if (live_bytes(MEMORY_CPU) == cpuBefore && live_bytes(MEMORY_GPU) == gpuBefore)
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return false;
+}
+
+//Gets a fresh entry into state, cancels it and checks the result
+bool check(const char* name, SceneLoader::AssetState state)
+{
+	for (int attempt = 1; attempt <= ATTEMPTS; attempt++)
+	{
+		size_t cpuBefore = live_bytes(MEMORY_CPU), gpuBefore = live_bytes(MEMORY_GPU);
+		SceneLoader scene(1);
+		size_t entry = scene.Add(MODEL_PATH, glm::vec3(0.0f));
+
+		Reached reached = reach(scene, entry, state);
+		if (reached == MISSED && state == SceneLoader::ASSET_IMPORTING && attempt < ATTEMPTS)
+			continue; //Nothing was uploaded yet, dropping the loader frees the import - try again
+		if (reached != REACHED)
+		{
+			std::cout << "ERROR::CHECK::CANCEL::" << name << (reached == MISSED ? "::STATE_MISSED" : "::TIMED_OUT") << std::endl;
+			return false;
+		}
+
+		scene.Cancel(entry);
+		if (scene.EntryState(entry) != SceneLoader::ASSET_CANCELLED)
+		{
+			std::cout << "ERROR::CHECK::CANCEL::" << name << "::NOT_CANCELLED" << std::endl;
+			return false;
+		}
+		if (!released(scene, cpuBefore, gpuBefore))
+		{
+			std::cout << "ERROR::CHECK::CANCEL::" << name << "::MEMORY_NOT_RELEASED::cpu " << (long long)(live_bytes(MEMORY_CPU) - cpuBefore)
+				<< " gpu " << (long long)(live_bytes(MEMORY_GPU) - gpuBefore) << " bytes" << std::endl;
+			return false;
+		}
+		std::cout << "Cancel while " << name << ": OK" << std::endl;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,391 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <iomanip>
+#include <cstring>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Shader.h"
+#include "Model.h"
+#include "ImageWriter.h"
+
+using namespace std;
+
+// Turntable Job //
+//One model rendered from a ring of cameras orbiting the origin
+struct TurntableJob
+{
+	string modelPath;
+	int frames;			//Number of views around the orbit
+	float radius;		//Distance of the camera from the origin
+	float elevation;	//Angle of the camera above the horizon (degrees)
+};
+
+struct BatchSettings
+{
+	int width = 512;
+	int height = 512;
+	string outputDir = ".";
+	string format = "png";	//png or exr
+	int encoderThreads = 4;
+	int readbackBuffers = 3;	//Size of the PBO ring
+};
+
+/*
+Reads a job list, one job per line:
+model_path frames radius elevation
+Empty lines and lines starting with # are skipped.
+*/
+inline bool LoadTurntableJobs(const string& path, vector<TurntableJob>& jobs)
+{
+	ifstream file(path.c_str());
+	if (!file)
+	{
+		cout << "ERROR::BATCH::COULD_NOT_OPEN::" << path << endl;
+		return false;
+	}
+	string line;
+	int lineNumber = 0;
+	while (getline(file, line))
+	{
+		lineNumber++;
+		if (line.empty() || line[0] == '#' || line[0] == '\r')
+			continue;
+		stringstream ss(line);
+		TurntableJob job;
+		if (!(ss >> job.modelPath >> job.frames >> job.radius >> job.elevation) || job.frames <= 0)
+		{
+			cout << "ERROR::BATCH::BAD_JOB::" << path << ":" << lineNumber << endl;
+			return false;
+		}
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+// Encoder Pool //
+/*
+Worker threads that write finished frames to disk.
+Submit blocks once enough frames are queued so a slow disk can't eat all memory.
+*/
+class EncoderPool
+{
+public:
+	EncoderPool(int threads)
+	{
+		this->maxQueued = threads * 4;
+		for (int i = 0; i < threads; i++)
+			this->workers.push_back(thread(&EncoderPool::work, this));
+	}
+	~EncoderPool()
+	{
+		this->Finish();
+	}
+
+	void Submit(const string& path, int width, int height, vector<unsigned char>& pixels)
+	{
+		unique_lock<mutex> lock(this->queueMutex);
+		this->spaceFree.wait(lock, [this]() { return this->queue.size() < this->maxQueued; });
+		Frame frame;
+		frame.path = path;
+		frame.width = width;
+		frame.height = height;
+		frame.pixels.swap(pixels);
+		this->queue.push_back(std::move(frame));
+		this->frameReady.notify_one();
+	}
+
+	//Writes everything left in the queue then stops the workers
+	void Finish()
+	{
+		{
+			lock_guard<mutex> lock(this->queueMutex);
+			this->finishing = true;
+		}
+		this->frameReady.notify_all();
+		for (size_t i = 0; i < this->workers.size(); i++)
+			this->workers[i].join();
+		this->workers.clear();
+	}
+
+	int Written() { return this->written; }
+	int Failed() { return this->failed; }
+
+private:
+	struct Frame
+	{
+		string path;
+		int width, height;
+		vector<unsigned char> pixels;
+	};
+
+	vector<thread> workers;
+	deque<Frame> queue;
+	size_t maxQueued;
+	mutex queueMutex;
+	condition_variable frameReady;
+	condition_variable spaceFree;
+	bool finishing = false;
+	int written = 0; //Guarded by queueMutex
+	int failed = 0;
+
+	void work()
+	{
+		for (;;)
+		{
+			Frame frame;
+			{
+				unique_lock<mutex> lock(this->queueMutex);
+				this->frameReady.wait(lock, [this]() { return !this->queue.empty() || this->finishing; });
+				if (this->queue.empty())
+					return; //Finishing and nothing left
+				frame = std::move(this->queue.front());
+				this->queue.pop_front();
+			}
+			this->spaceFree.notify_one();
+
+			bool ok = ImageWriter::Write(frame.path, frame.width, frame.height, &frame.pixels[0]);
+
+			lock_guard<mutex> lock(this->queueMutex);
+			if (ok)
+				this->written++;
+			else
+				this->failed++;
+		}
+	}
+};
+
+// Batch Renderer //
+/*
+Renders turntable views of many models into an offscreen framebuffer and writes them to image files.
+
+Pipeline (so neither the GPU nor the CPU waits on the other):
+1. The next job's model is imported on a background thread while the current one renders
+2. Each frame is rendered into an FBO and read back into one of a ring of pixel buffer objects
+   (glReadPixels into a PBO returns immediately, a fence marks when the copy is done)
+3. A PBO is only mapped once its fence has signalled, or when the ring wraps around to it
+4. The mapped pixels are handed to the encoder pool, which writes PNG/EXR files
+*/
+class BatchRenderer
+{
+public:
+	BatchRenderer(const BatchSettings& settings, Shader& shader)
+		: settings(settings), shader(shader)
+	{
+		// Framebuffer (colour + depth renderbuffers) //
+		glGenFramebuffers(1, &this->FBO);
+		glGenRenderbuffers(1, &this->colourRBO);
+		glGenRenderbuffers(1, &this->depthRBO);
+
+		glBindRenderbuffer(GL_RENDERBUFFER, this->colourRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, settings.width, settings.height);
+		glBindRenderbuffer(GL_RENDERBUFFER, this->depthRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, settings.width, settings.height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->colourRBO);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->depthRBO);
+		this->framebufferComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		if (!this->framebufferComplete)
+			cout << "ERROR::BATCH::FRAMEBUFFER_INCOMPLETE" << endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		// Readback Ring //
+		this->ring.resize(settings.readbackBuffers > 0 ? settings.readbackBuffers : 1);
+		for (size_t i = 0; i < this->ring.size(); i++)
+		{
+			glGenBuffers(1, &this->ring[i].PBO);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, this->ring[i].PBO);
+			glBufferData(GL_PIXEL_PACK_BUFFER, this->frameBytes(), NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	~BatchRenderer()
+	{
+		for (size_t i = 0; i < this->ring.size(); i++)
+		{
+			if (this->ring[i].fence)
+				glDeleteSync(this->ring[i].fence);
+			glDeleteBuffers(1, &this->ring[i].PBO);
+		}
+		glDeleteRenderbuffers(1, &this->colourRBO);
+		glDeleteRenderbuffers(1, &this->depthRBO);
+		glDeleteFramebuffers(1, &this->FBO);
+	}
+
+	//Renders every job, returns the number of images written (0 if the framebuffer couldn't be set up)
+	int Run(const vector<TurntableJob>& jobs)
+	{
+		if (jobs.empty() || !this->framebufferComplete)
+			return 0; //Rendering into an incomplete framebuffer would only write garbage images
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		EncoderPool encoders(this->settings.encoderThreads > 0 ? this->settings.encoderThreads : 1);
+
+		glViewport(0, 0, this->settings.width, this->settings.height);
+		glEnable(GL_DEPTH_TEST);
+
+		future<unique_ptr<Model> > next = async(launch::async, importModel, jobs[0].modelPath);
+		for (size_t i = 0; i < jobs.size(); i++)
+		{
+			unique_ptr<Model> model = next.get();
+			//Start importing job N+1 while job N renders
+			if (i + 1 < jobs.size())
+				next = async(launch::async, importModel, jobs[i + 1].modelPath);
+			if (!model)
+				continue; //Import already reported the error
+
+			model->Upload();
+			for (int frame = 0; frame < jobs[i].frames; frame++)
+			{
+				this->renderFrame(*model, jobs[i], frame);
+				this->readback(encoders, this->frameName(jobs[i], i, frame));
+			}
+			//Safe while readbacks are in flight, GL keeps the objects alive until the GPU is done with them
+			model->Release();
+		}
+
+		//Collect the frames still in the ring, then let the encoders catch up
+		for (size_t n = 0; n < this->ring.size(); n++)
+		{
+			this->resolve(encoders, this->ring[this->nextSlot]);
+			this->nextSlot = (this->nextSlot + 1) % this->ring.size();
+		}
+		encoders.Finish();
+
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		cout << "Rendered " << encoders.Written() << " images in " << seconds << "s ("
+			<< (seconds > 0.0 ? encoders.Written() / seconds : 0.0) << " images/s)";
+		if (encoders.Failed() > 0)
+			cout << ", " << encoders.Failed() << " failed to write";
+		cout << endl;
+		return encoders.Written();
+	}
+
+private:
+	struct Readback
+	{
+		GLuint PBO = 0;
+		GLsync fence = 0;	//Set while a glReadPixels into this PBO is in flight
+		string path;		//Where the frame goes once it's read back
+	};
+
+	BatchSettings settings;
+	Shader& shader;
+	GLuint FBO, colourRBO, depthRBO;
+	bool framebufferComplete;
+	vector<Readback> ring;
+	size_t nextSlot = 0; //Oldest slot, next one to be reused
+
+	size_t frameBytes() { return (size_t)this->settings.width * this->settings.height * 4; }
+
+	//Runs on a loader thread - no GL calls
+	static unique_ptr<Model> importModel(string path)
+	{
+		unique_ptr<Model> model(new Model());
+		if (!model->Import(path))
+			return unique_ptr<Model>();
+		return model;
+	}
+
+	//<output dir>/<job index>_<model file name>_<frame>.<format>
+	string frameName(const TurntableJob& job, size_t jobIndex, int frame)
+	{
+		string file = job.modelPath.substr(job.modelPath.find_last_of("/\\") + 1);
+		file = file.substr(0, file.find_last_of('.'));
+		stringstream ss;
+		ss << this->settings.outputDir << '/' << jobIndex << '_' << file << '_' << setw(4) << setfill('0') << frame << '.' << this->settings.format;
+		return ss.str();
+	}
+
+	void renderFrame(Model& model, const TurntableJob& job, int frame)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		//Camera position on the orbit
+		GLfloat angle = glm::radians(360.0f * frame / job.frames);
+		GLfloat elevation = glm::radians(job.elevation);
+		glm::vec3 eye(job.radius * cos(elevation) * sin(angle), job.radius * sin(elevation), job.radius * cos(elevation) * cos(angle));
+
+		glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (GLfloat)this->settings.width / (GLfloat)this->settings.height, 0.1f, 100.0f);
+		glm::mat4 modelMatrix;
+
+		this->shader.Use();
+		glUniformMatrix4fv(glGetUniformLocation(this->shader.Program, "model"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
+		glUniformMatrix4fv(glGetUniformLocation(this->shader.Program, "view"), 1, GL_FALSE, glm::value_ptr(view));
+		glUniformMatrix4fv(glGetUniformLocation(this->shader.Program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+		model.Draw(this->shader);
+	}
+
+	//Queues an asynchronous copy of the framebuffer into the next PBO of the ring
+	void readback(EncoderPool& encoders, const string& path)
+	{
+		//Ring wrapped around - the oldest frame has to come out first
+		Readback& slot = this->ring[this->nextSlot];
+		this->resolve(encoders, slot);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+		glReadPixels(0, 0, this->settings.width, this->settings.height, GL_RGBA, GL_UNSIGNED_BYTE, 0); //Writes into the PBO, doesn't wait
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.path = path;
+		this->nextSlot = (this->nextSlot + 1) % this->ring.size();
+
+		//Pick up any older frames the GPU has already finished, in order, without waiting
+		for (size_t n = 0; n + 1 < this->ring.size(); n++)
+		{
+			Readback& ready = this->ring[(this->nextSlot + n) % this->ring.size()];
+			if (!ready.fence)
+				continue;
+			if (glClientWaitSync(ready.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+				break;
+			this->resolve(encoders, ready);
+		}
+	}
+
+	//Waits for the slot's copy (if any), maps it and hands the pixels to the encoders
+	void resolve(EncoderPool& encoders, Readback& slot)
+	{
+		if (!slot.fence)
+			return;
+		//Flush so the fence is guaranteed to signal, then wait (1 second at a time)
+		while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+
+		vector<unsigned char> pixels(this->frameBytes());
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+		void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, this->frameBytes(), GL_MAP_READ_BIT);
+		if (mapped)
+		{
+			memcpy(&pixels[0], mapped, this->frameBytes());
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		else
+			cout << "ERROR::BATCH::COULD_NOT_MAP_PIXEL_BUFFER" << endl;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		if (mapped)
+			encoders.Submit(slot.path, this->settings.width, this->settings.height, pixels);
+	}
+};
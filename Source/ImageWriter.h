@@ -0,0 +1,259 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+// Image Writer //
+/*
+Writes RGBA8 pixels (as read back by glReadPixels) to PNG or OpenEXR files.
+SOIL can only save BMP/TGA/DDS, so both formats are written here without any extra library:
+PNG uses uncompressed (stored) deflate blocks, EXR uses uncompressed 32 bit float scanlines.
+Rows are expected bottom-up like OpenGL returns them, and are flipped while writing.
+*/
+namespace ImageWriter
+{
+	// Byte Helpers //
+	inline void putU32BE(std::vector<unsigned char>& out, unsigned int value)
+	{
+		out.push_back((unsigned char)(value >> 24));
+		out.push_back((unsigned char)(value >> 16));
+		out.push_back((unsigned char)(value >> 8));
+		out.push_back((unsigned char)value);
+	}
+
+	inline void putU32LE(std::vector<unsigned char>& out, unsigned int value)
+	{
+		out.push_back((unsigned char)value);
+		out.push_back((unsigned char)(value >> 8));
+		out.push_back((unsigned char)(value >> 16));
+		out.push_back((unsigned char)(value >> 24));
+	}
+
+	inline void putU64LE(std::vector<unsigned char>& out, unsigned long long value)
+	{
+		putU32LE(out, (unsigned int)value);
+		putU32LE(out, (unsigned int)(value >> 32));
+	}
+
+	inline void putFloatLE(std::vector<unsigned char>& out, float value)
+	{
+		unsigned int bits;
+		memcpy(&bits, &value, sizeof(bits));
+		putU32LE(out, bits);
+	}
+
+	inline void putString(std::vector<unsigned char>& out, const char* text)
+	{
+		while (*text)
+			out.push_back((unsigned char)*text++);
+		out.push_back(0); //Null terminated
+	}
+
+	inline bool writeFile(const std::string& path, const std::vector<unsigned char>& data)
+	{
+		std::ofstream file(path.c_str(), std::ios::binary);
+		if (!file)
+		{
+			std::cout << "ERROR::IMAGE::COULD_NOT_WRITE::" << path << std::endl;
+			return false;
+		}
+		file.write((const char*)&data[0], data.size());
+		file.close();
+		if (!file.good()) //e.g. the disk is full
+		{
+			std::cout << "ERROR::IMAGE::WRITE_FAILED::" << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	// PNG //
+	struct CrcTable
+	{
+		unsigned int entries[256];
+		CrcTable()
+		{
+			for (unsigned int n = 0; n < 256; n++)
+			{
+				unsigned int c = n;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				this->entries[n] = c;
+			}
+		}
+	};
+
+	inline unsigned int crc32(const unsigned char* data, size_t length)
+	{
+		static const CrcTable table; //Built once, thread safe since C++11
+		unsigned int crc = 0xFFFFFFFFu;
+		for (size_t i = 0; i < length; i++)
+			crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	//Appends a PNG chunk: length, type, data, CRC of type + data
+	inline void putChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+	{
+		putU32BE(out, (unsigned int)data.size());
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data.begin(), data.end());
+		putU32BE(out, crc32(&out[start], out.size() - start));
+	}
+
+	inline bool WritePNG(const std::string& path, int width, int height, const unsigned char* rgba)
+	{
+		//Raw scanlines, each starting with filter type 0 (none)
+		size_t stride = (size_t)width * 4;
+		std::vector<unsigned char> raw;
+		raw.reserve((stride + 1) * height);
+		for (int y = height - 1; y >= 0; y--)
+		{
+			raw.push_back(0);
+			raw.insert(raw.end(), rgba + y * stride, rgba + (y + 1) * stride);
+		}
+
+		//zlib stream made of stored deflate blocks (max 65535 bytes each)
+		std::vector<unsigned char> zlib;
+		zlib.push_back(0x78);
+		zlib.push_back(0x01);
+		size_t offset = 0;
+		do
+		{
+			size_t block = raw.size() - offset < 65535 ? raw.size() - offset : 65535;
+			bool last = offset + block == raw.size();
+			zlib.push_back(last ? 1 : 0);
+			zlib.push_back((unsigned char)block);
+			zlib.push_back((unsigned char)(block >> 8));
+			zlib.push_back((unsigned char)~block);
+			zlib.push_back((unsigned char)(~block >> 8));
+			zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + block);
+			offset += block;
+		} while (offset < raw.size());
+
+		//Adler-32 of the uncompressed data
+		unsigned int a = 1, b = 0;
+		for (size_t i = 0; i < raw.size(); i++)
+		{
+			a = (a + raw[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		putU32BE(zlib, (b << 16) | a);
+
+		std::vector<unsigned char> header;
+		putU32BE(header, width);
+		putU32BE(header, height);
+		header.push_back(8); //Bit depth
+		header.push_back(6); //Colour type RGBA
+		header.push_back(0); //Compression
+		header.push_back(0); //Filter
+		header.push_back(0); //Interlace
+
+		static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		std::vector<unsigned char> png(signature, signature + 8);
+		putChunk(png, "IHDR", header);
+		putChunk(png, "IDAT", zlib);
+		putChunk(png, "IEND", std::vector<unsigned char>());
+		return writeFile(path, png);
+	}
+
+	// EXR //
+	//EXR stores linear light, the framebuffer holds sRGB encoded values
+	inline float srgbToLinear(unsigned char value)
+	{
+		float c = value / 255.0f;
+		return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	inline void putAttribute(std::vector<unsigned char>& out, const char* name, const char* type, const std::vector<unsigned char>& value)
+	{
+		putString(out, name);
+		putString(out, type);
+		putU32LE(out, (unsigned int)value.size());
+		out.insert(out.end(), value.begin(), value.end());
+	}
+
+	inline bool WriteEXR(const std::string& path, int width, int height, const unsigned char* rgba)
+	{
+		std::vector<unsigned char> exr;
+		putU32LE(exr, 20000630); //Magic number
+		putU32LE(exr, 2); //Version 2, single part scanline file
+
+		//Channels have to be listed in alphabetical order
+		static const char* channelNames[4] = { "A", "B", "G", "R" };
+		static const int channelOffsets[4] = { 3, 2, 1, 0 }; //Where each channel sits in an RGBA pixel
+		std::vector<unsigned char> channels;
+		for (int c = 0; c < 4; c++)
+		{
+			putString(channels, channelNames[c]);
+			putU32LE(channels, 2); //FLOAT
+			putU32LE(channels, 0); //pLinear + reserved
+			putU32LE(channels, 1); //x sampling
+			putU32LE(channels, 1); //y sampling
+		}
+		channels.push_back(0);
+		putAttribute(exr, "channels", "chlist", channels);
+
+		putAttribute(exr, "compression", "compression", std::vector<unsigned char>(1, 0)); //NO_COMPRESSION
+
+		std::vector<unsigned char> window;
+		putU32LE(window, 0);
+		putU32LE(window, 0);
+		putU32LE(window, width - 1);
+		putU32LE(window, height - 1);
+		putAttribute(exr, "dataWindow", "box2i", window);
+		putAttribute(exr, "displayWindow", "box2i", window);
+
+		putAttribute(exr, "lineOrder", "lineOrder", std::vector<unsigned char>(1, 0)); //INCREASING_Y
+
+		std::vector<unsigned char> value;
+		putFloatLE(value, 1.0f);
+		putAttribute(exr, "pixelAspectRatio", "float", value);
+
+		value.clear();
+		putFloatLE(value, 0.0f);
+		putFloatLE(value, 0.0f);
+		putAttribute(exr, "screenWindowCenter", "v2f", value);
+
+		value.clear();
+		putFloatLE(value, 1.0f);
+		putAttribute(exr, "screenWindowWidth", "float", value);
+		exr.push_back(0); //End of header
+
+		//Offset table, one entry per scanline (each line is its own chunk when uncompressed)
+		size_t stride = (size_t)width * 4;
+		size_t lineBytes = 8 + (size_t)width * 4 * sizeof(float);
+		unsigned long long offset = exr.size() + (unsigned long long)height * 8;
+		for (int y = 0; y < height; y++)
+			putU64LE(exr, offset + (unsigned long long)y * lineBytes);
+
+		exr.reserve(exr.size() + height * lineBytes);
+		for (int y = 0; y < height; y++)
+		{
+			const unsigned char* row = rgba + (height - 1 - y) * stride; //EXR is top-down
+			putU32LE(exr, y);
+			putU32LE(exr, (unsigned int)(lineBytes - 8));
+			for (int c = 0; c < 4; c++)
+				for (int x = 0; x < width; x++)
+				{
+					unsigned char v = row[x * 4 + channelOffsets[c]];
+					putFloatLE(exr, c == 0 ? v / 255.0f : srgbToLinear(v)); //Alpha is already linear
+				}
+		}
+		return writeFile(path, exr);
+	}
+
+	//Picks the format from the file extension (.exr, anything else is PNG)
+	inline bool Write(const std::string& path, int width, int height, const unsigned char* rgba)
+	{
+		size_t dot = path.find_last_of('.');
+		if (dot != std::string::npos && path.substr(dot) == ".exr")
+			return WriteEXR(path, width, height, rgba);
+		return WritePNG(path, width, height, rgba);
+	}
+}
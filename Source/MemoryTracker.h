@@ -0,0 +1,410 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <cstddef>
+
+// Memory Categories //
+//Every tracked allocation is tagged with a category so totals can be broken down by what they hold
+enum MemoryCategory
+{
+	MEMORY_VERTICES,		//Mesh vertex data (CPU copy kept by Mesh + VBO)
+	MEMORY_INDICES,			//Mesh index data (CPU copy kept by Mesh + EBO)
+	MEMORY_TEXTURE_INFO,	//Texture structs (id, type and the aiString path - over 1KB each)
+	MEMORY_TEXTURE_IMAGE,	//Decoded image pixels + GL texture including its mipmap chain
+	MEMORY_SHADER,			//Shader source code + linked program
+	MEMORY_CATEGORY_COUNT
+};
+
+//CPU bytes are exact, GPU bytes are estimates (GL doesn't tell us what the driver really allocates)
+enum MemorySide
+{
+	MEMORY_CPU,
+	MEMORY_GPU,
+	MEMORY_SIDE_COUNT
+};
+
+//What happens once a budget is exceeded
+enum MemoryBudgetPolicy
+{
+	BUDGET_WARN,	//Print a warning (once per time the budget is crossed)
+	BUDGET_EVICT	//Warn, then unload the least recently drawn owners in EnforceBudgets()
+};
+
+typedef unsigned int MemoryHandle; //0 = nothing tracked
+typedef unsigned int EvictableHandle; //0 = not registered
+
+inline const char* MemoryCategoryName(MemoryCategory category)
+{
+	static const char* names[MEMORY_CATEGORY_COUNT] = { "vertices", "indices", "texture_info", "texture_image", "shader" };
+	return names[category];
+}
+
+inline const char* MemorySideName(MemorySide side)
+{
+	return side == MEMORY_CPU ? "cpu" : "gpu";
+}
+
+// Estimate GPU size of a 2D texture //
+/*
+Drivers pad 3 channel formats out to 4 bytes per texel, so RGB textures should pass 4.
+A full mipmap chain adds roughly a third on top of the base level.
+*/
+inline size_t EstimateTextureBytes(int width, int height, int bytesPerTexel, bool mipmapped)
+{
+	size_t total = 0;
+	while (width > 0 && height > 0)
+	{
+		total += (size_t)width * (size_t)height * (size_t)bytesPerTexel;
+		if (!mipmapped || (width == 1 && height == 1))
+			break;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return total;
+}
+
+//Live/peak bytes and number of live allocations
+struct MemoryCounter
+{
+	size_t live = 0;
+	size_t peak = 0;
+	size_t allocations = 0;
+
+	void Add(size_t bytes)
+	{
+		this->live += bytes;
+		this->allocations++;
+		if (this->live > this->peak)
+			this->peak = this->live;
+	}
+	void Remove(size_t bytes)
+	{
+		this->live -= bytes;
+		this->allocations--;
+	}
+};
+
+struct OwnerMemory
+{
+	MemoryCounter side[MEMORY_SIDE_COUNT];
+};
+
+//Copy of all the counters at one point in time - safe to read while loading carries on
+struct MemorySnapshot
+{
+	MemoryCounter total[MEMORY_SIDE_COUNT];
+	MemoryCounter category[MEMORY_SIDE_COUNT][MEMORY_CATEGORY_COUNT];
+	std::map<std::string, OwnerMemory> owners;
+	size_t budget[MEMORY_SIDE_COUNT];
+	size_t evictions;
+};
+
+// Memory Tracker //
+/*
+Process wide accounting of everything Model (meshes and textures), Mesh and Shader allocate.
+Each allocation is tagged with an owner (usually the model's file path) and a category.
+
+Budgets are checked on every Track call, but eviction only happens in EnforceBudgets() which
+must be called from the thread owning the GL context (once per frame), because evicting
+an owner deletes its GL objects.
+*/
+class MemoryTracker
+{
+public:
+	static MemoryTracker& Get()
+	{
+		static MemoryTracker tracker;
+		return tracker;
+	}
+
+	// Allocations //
+	MemoryHandle Track(const std::string& owner, MemoryCategory category, MemorySide side, size_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		MemoryHandle handle = this->nextHandle++;
+		Allocation allocation = { owner, category, side, bytes };
+		this->allocations[handle] = allocation;
+
+		this->total[side].Add(bytes);
+		this->category[side][category].Add(bytes);
+		this->owners[owner].side[side].Add(bytes);
+
+		this->checkBudget(side);
+		return handle;
+	}
+
+	void Release(MemoryHandle handle)
+	{
+		if (handle == 0)
+			return;
+		std::lock_guard<std::mutex> lock(this->mutex);
+		std::map<MemoryHandle, Allocation>::iterator it = this->allocations.find(handle);
+		if (it == this->allocations.end())
+			return;
+
+		const Allocation& allocation = it->second;
+		this->total[allocation.side].Remove(allocation.bytes);
+		this->category[allocation.side][allocation.category].Remove(allocation.bytes);
+		OwnerMemory& owner = this->owners[allocation.owner];
+		owner.side[allocation.side].Remove(allocation.bytes);
+		//Forget owners once everything they had is gone so the dump doesn't grow forever
+		if (owner.side[MEMORY_CPU].allocations == 0 && owner.side[MEMORY_GPU].allocations == 0)
+			this->owners.erase(allocation.owner);
+
+		if (this->total[allocation.side].live <= this->budget[allocation.side])
+			this->overBudget[allocation.side] = false;
+		this->allocations.erase(it);
+	}
+
+	void Release(std::vector<MemoryHandle>& handles)
+	{
+		for (size_t i = 0; i < handles.size(); i++)
+			this->Release(handles[i]);
+		handles.clear();
+	}
+
+	// Budgets //
+	//bytes = 0 means unlimited
+	void SetBudget(MemorySide side, size_t bytes, MemoryBudgetPolicy policy)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->budget[side] = bytes;
+		this->policy[side] = policy;
+		this->overBudget[side] = false;
+		this->checkBudget(side);
+	}
+
+	//Whether this many more bytes would still be within every evicting budget
+	bool HasRoom(size_t cpuBytes, size_t gpuBytes)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		size_t bytes[MEMORY_SIDE_COUNT] = { cpuBytes, gpuBytes };
+		for (int side = 0; side < MEMORY_SIDE_COUNT; side++)
+			if (this->policy[side] == BUDGET_EVICT && this->budget[side] != 0 && this->total[side].live + bytes[side] > this->budget[side])
+				return false;
+		return true;
+	}
+
+	//What one owner currently has allocated
+	OwnerMemory Usage(const std::string& owner)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		std::map<std::string, OwnerMemory>::iterator it = this->owners.find(owner);
+		return it != this->owners.end() ? it->second : OwnerMemory();
+	}
+
+	/*
+	Registers something that can be unloaded when an evicting budget is exceeded.
+	Each registration gets its own handle, so two models of the same file don't replace each other,
+	owner is only used for messages. Once evicted the handle is forgotten.
+	*/
+	EvictableHandle RegisterEvictable(const std::string& owner, std::function<void()> evict)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		EvictableHandle handle = this->nextEvictable++;
+		Evictable evictable = { owner, evict, this->frame, 0.0f };
+		this->evictables[handle] = evictable;
+		return handle;
+	}
+
+	void UnregisterEvictable(EvictableHandle handle)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->evictables.erase(handle);
+	}
+
+	//Marks a registration as used this frame (called when it is drawn), distance = how far from the camera it was drawn
+	void Touch(EvictableHandle handle, float distance = 0.0f)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		std::map<EvictableHandle, Evictable>::iterator it = this->evictables.find(handle);
+		if (it != this->evictables.end())
+		{
+			it->second.lastUsed = this->frame;
+			it->second.distance = distance;
+		}
+	}
+
+	/*
+	Call once per frame on the GL thread.
+	Unloads least recently drawn owners until every evicting budget is met again.
+	Owners drawn equally recently (e.g. everything drawn in the frame that just finished) go farthest first.
+	*/
+	void EnforceBudgets()
+	{
+		for (;;)
+		{
+			std::function<void()> evict;
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				if (!this->needsEviction())
+					break;
+
+				std::map<EvictableHandle, Evictable>::iterator victim = this->evictables.end();
+				for (std::map<EvictableHandle, Evictable>::iterator it = this->evictables.begin(); it != this->evictables.end(); ++it)
+				{
+					if (victim == this->evictables.end() || it->second.lastUsed < victim->second.lastUsed
+						|| (it->second.lastUsed == victim->second.lastUsed && it->second.distance > victim->second.distance))
+						victim = it;
+				}
+				if (victim == this->evictables.end())
+					break; //Nothing left to unload
+
+				std::cout << "WARNING::MEMORY::EVICTING::" << victim->second.owner << std::endl;
+				evict = victim->second.evict;
+				this->evictables.erase(victim);
+				this->evictions++;
+			}
+			//Run outside the lock, the callback releases its handles through this tracker
+			evict();
+		}
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->frame++;
+	}
+
+	// Queries //
+	MemorySnapshot Snapshot()
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		MemorySnapshot snapshot;
+		for (int side = 0; side < MEMORY_SIDE_COUNT; side++)
+		{
+			snapshot.total[side] = this->total[side];
+			snapshot.budget[side] = this->budget[side];
+			for (int category = 0; category < MEMORY_CATEGORY_COUNT; category++)
+				snapshot.category[side][category] = this->category[side][category];
+		}
+		snapshot.owners = this->owners;
+		snapshot.evictions = this->evictions;
+		return snapshot;
+	}
+
+	void DumpJSON(std::ostream& out)
+	{
+		MemorySnapshot snapshot = this->Snapshot();
+
+		out << "{\n";
+		for (int side = 0; side < MEMORY_SIDE_COUNT; side++)
+		{
+			out << "  \"" << MemorySideName((MemorySide)side) << "\": {\n";
+			out << "    \"budget\": " << snapshot.budget[side] << ",\n";
+			out << "    \"total\": ";
+			writeCounter(out, snapshot.total[side]);
+			out << ",\n    \"categories\": {\n";
+			for (int category = 0; category < MEMORY_CATEGORY_COUNT; category++)
+			{
+				out << "      \"" << MemoryCategoryName((MemoryCategory)category) << "\": ";
+				writeCounter(out, snapshot.category[side][category]);
+				out << (category + 1 < MEMORY_CATEGORY_COUNT ? ",\n" : "\n");
+			}
+			out << "    }\n  },\n";
+		}
+		out << "  \"evictions\": " << snapshot.evictions << ",\n";
+		out << "  \"owners\": {";
+		for (std::map<std::string, OwnerMemory>::iterator it = snapshot.owners.begin(); it != snapshot.owners.end(); ++it)
+		{
+			out << (it == snapshot.owners.begin() ? "\n" : ",\n");
+			out << "    \"" << escapeJSON(it->first) << "\": { \"cpu\": ";
+			writeCounter(out, it->second.side[MEMORY_CPU]);
+			out << ", \"gpu\": ";
+			writeCounter(out, it->second.side[MEMORY_GPU]);
+			out << " }";
+		}
+		out << "\n  }\n}\n";
+	}
+
+	bool DumpJSON(const std::string& path)
+	{
+		std::ofstream file(path.c_str());
+		if (!file)
+		{
+			std::cout << "ERROR::MEMORY::COULD_NOT_WRITE::" << path << std::endl;
+			return false;
+		}
+		this->DumpJSON(file);
+		return true;
+	}
+
+private:
+	struct Allocation
+	{
+		std::string owner;
+		MemoryCategory category;
+		MemorySide side;
+		size_t bytes;
+	};
+
+	struct Evictable
+	{
+		std::string owner;
+		std::function<void()> evict;
+		unsigned long long lastUsed;
+		float distance; //From the camera when last drawn
+	};
+
+	std::mutex mutex;
+	MemoryHandle nextHandle = 1;
+	std::map<MemoryHandle, Allocation> allocations;
+	MemoryCounter total[MEMORY_SIDE_COUNT];
+	MemoryCounter category[MEMORY_SIDE_COUNT][MEMORY_CATEGORY_COUNT];
+	std::map<std::string, OwnerMemory> owners;
+
+	size_t budget[MEMORY_SIDE_COUNT] = { 0, 0 };
+	MemoryBudgetPolicy policy[MEMORY_SIDE_COUNT] = { BUDGET_WARN, BUDGET_WARN };
+	bool overBudget[MEMORY_SIDE_COUNT] = { false, false };
+	std::map<EvictableHandle, Evictable> evictables;
+	EvictableHandle nextEvictable = 1;
+	unsigned long long frame = 1;
+	size_t evictions = 0;
+
+	MemoryTracker() {}
+	MemoryTracker(const MemoryTracker&) = delete;
+	MemoryTracker& operator=(const MemoryTracker&) = delete;
+
+	//Expects mutex to be held
+	void checkBudget(int side)
+	{
+		if (this->budget[side] == 0 || this->total[side].live <= this->budget[side] || this->overBudget[side])
+			return;
+		this->overBudget[side] = true; //Only warn once per crossing
+		std::cout << "WARNING::MEMORY::" << (side == MEMORY_CPU ? "CPU" : "GPU") << "_BUDGET_EXCEEDED::"
+			<< this->total[side].live << "/" << this->budget[side] << " bytes" << std::endl;
+	}
+
+	//Expects mutex to be held
+	bool needsEviction()
+	{
+		for (int side = 0; side < MEMORY_SIDE_COUNT; side++)
+			if (this->policy[side] == BUDGET_EVICT && this->budget[side] != 0 && this->total[side].live > this->budget[side])
+				return true;
+		return false;
+	}
+
+	static void writeCounter(std::ostream& out, const MemoryCounter& counter)
+	{
+		out << "{ \"live\": " << counter.live << ", \"peak\": " << counter.peak << ", \"allocations\": " << counter.allocations << " }";
+	}
+
+	static std::string escapeJSON(const std::string& text)
+	{
+		std::ostringstream escaped;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			char c = text[i];
+			if (c == '"' || c == '\\')
+				escaped << '\\' << c;
+			else if ((unsigned char)c < 0x20)
+				escaped << "\\u00" << "0123456789abcdef"[(c >> 4) & 0xF] << "0123456789abcdef"[c & 0xF];
+			else
+				escaped << c;
+		}
+		return escaped.str();
+	}
+};
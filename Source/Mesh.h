@@ -11,6 +11,8 @@ using namespace std;
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "MemoryTracker.h"
+
 //For indexing each of vertex attributes
 struct Vertex {
 	glm::vec3 Position;
@@ -31,13 +33,15 @@ class Mesh {
 		vector<Vertex> vertices;
 		vector<GLuint> indices;
 		vector<Texture> textures;
+		string owner; //Name memory is accounted under (the model's path)
 
 		// Functions //
-		Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures) //Constructor
+		Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures, string owner = "unowned") //Constructor
 		{
 			this->vertices = vertices;
 			this->indices = indices;
 			this->textures = textures;
+			this->owner = owner;
 
 			this->setupMesh();
 		}
@@ -83,12 +87,23 @@ class Mesh {
 
 		}
 
-
+		//Deletes GL objects and frees the CPU copies
+		void Release()
+		{
+			glDeleteVertexArrays(1, &this->VAO);
+			glDeleteBuffers(1, &this->VBO);
+			glDeleteBuffers(1, &this->EBO);
+			vector<Vertex>().swap(this->vertices);
+			vector<GLuint>().swap(this->indices);
+			vector<Texture>().swap(this->textures);
+			MemoryTracker::Get().Release(this->memory);
+		}
 
 
 	private:
 		// Render Data //
 		GLuint VAO, VBO, EBO;
+		vector<MemoryHandle> memory; //Tracked allocations, released in Release()
 
 		// Functions //
 		void setupMesh()
@@ -113,6 +128,14 @@ class Mesh {
 			4. Specifies how we want the graphics card to manage given data
 			*/
 
+			//Account for the buffers on the GPU and the copies Mesh keeps resident on the CPU
+			MemoryTracker& tracker = MemoryTracker::Get();
+			this->memory.push_back(tracker.Track(this->owner, MEMORY_VERTICES, MEMORY_GPU, this->vertices.size() * sizeof(Vertex)));
+			this->memory.push_back(tracker.Track(this->owner, MEMORY_INDICES, MEMORY_GPU, this->indices.size() * sizeof(GLuint)));
+			this->memory.push_back(tracker.Track(this->owner, MEMORY_VERTICES, MEMORY_CPU, this->vertices.capacity() * sizeof(Vertex)));
+			this->memory.push_back(tracker.Track(this->owner, MEMORY_INDICES, MEMORY_CPU, this->indices.capacity() * sizeof(GLuint)));
+			this->memory.push_back(tracker.Track(this->owner, MEMORY_TEXTURE_INFO, MEMORY_CPU, this->textures.capacity() * sizeof(Texture)));
+
 			//Vertex Positions
 			glEnableVertexAttribArray(0);
 			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
@@ -6,6 +6,8 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <atomic>
+#include <chrono>
 
 using namespace std;
 
@@ -19,7 +21,12 @@ using namespace std;
 
 #include "Mesh.h"
 
-GLuint TextureFromFile(const char* path, string directory);
+//Time Import spent in each phase (milliseconds)
+struct ModelLoadStats
+{
+	double parseMs = 0.0;	//Assimp reading the file
+	double convertMs = 0.0;	//Copying into Vertex/index lists and decoding textures
+};
 
 class Model
 {
@@ -29,26 +36,173 @@ public:
 	//Constructor - expects a filepath to a 3D model
 	Model(GLchar* path)
 	{
-		this->loadModel(path);
+		this->Import(path);
+		this->Upload();
+	}
+	//Empty model, fill it with Import then Upload (lets the import happen on another thread)
+	Model() {}
+	~Model()
+	{
+		//GL objects are left alone - the context may already be gone by now
+		MemoryTracker::Get().UnregisterEvictable(this->evictable);
+		this->freePending();
 	}
+	//Not copyable, the eviction callback points at this instance
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+
 	void Draw(Shader shader) //Draws model
 	{
+		MemoryTracker::Get().Touch(this->evictable);
 		for (GLuint i = 0; i < this->meshes.size(); i++)
 			this->meshes[i].Draw(shader);
 	}
 
+	// Import //
+	/*
+	Reads the file with Assimp and decodes its textures into CPU memory.
+	Makes no GL calls, so it is safe to run on a thread without a GL context.
+	Returns false if the file couldn't be read, or if cancel was set while importing.
+	*/
+	bool Import(string path, const atomic<bool>* cancel = NULL)
+	{
+		this->name = path;
+		this->cancel = cancel;
+		bool loaded = this->loadModel(path) && !this->cancelled();
+		this->cancel = NULL;
+		return loaded;
+	}
+
+	// Upload //
+	/*
+	Creates the GL buffers and textures for everything Import read, then frees the CPU staging data.
+	Must run on the thread owning the GL context.
+	Registers the model with MemoryTracker so an evicting budget can unload it (see MemoryTracker::EnforceBudgets).
+	*/
+	void Upload()
+	{
+		while (!this->UploadStep((size_t)-1)) {}
+		MemoryTracker& tracker = MemoryTracker::Get();
+		tracker.UnregisterEvictable(this->evictable);
+		this->evictable = tracker.RegisterEvictable(this->name, [this]() { this->Release(); });
+	}
+
+	/*
+	Time sliced version of Upload - uploads textures then meshes until roughly byteBudget bytes
+	have been sent (always at least one), freeing each one's staging data as it goes.
+	Returns true once everything is uploaded and the model is ready to draw.
+	uploadedBytes (optional) receives how much this step sent.
+	Doesn't register for eviction - the caller knows when the model actually becomes visible.
+	*/
+	bool UploadStep(size_t byteBudget, size_t* uploadedBytes = NULL)
+	{
+		size_t uploaded = 0;
+		MemoryTracker& tracker = MemoryTracker::Get();
+
+		for (; this->uploaded_images < this->pending_images.size(); this->uploaded_images++)
+		{
+			if (uploaded > 0 && uploaded >= byteBudget)
+				return this->stepDone(false, uploaded, uploadedBytes);
+			PendingImage& image = this->pending_images[this->uploaded_images];
+			this->textures_loaded[this->uploaded_images].id = this->uploadTexture(image);
+			uploaded += (size_t)image.width * image.height * 3;
+
+			if (image.pixels)
+				SOIL_free_image_data(image.pixels);
+			image.pixels = NULL;
+			tracker.Release(image.memory);
+			image.memory = 0;
+		}
+
+		for (; this->uploaded_meshes < this->pending_meshes.size(); this->uploaded_meshes++)
+		{
+			if (uploaded > 0 && uploaded >= byteBudget)
+				return this->stepDone(false, uploaded, uploadedBytes);
+			PendingMesh& pending = this->pending_meshes[this->uploaded_meshes];
+			vector<Texture> textures;
+			for (GLuint j = 0; j < pending.textures.size(); j++)
+				textures.push_back(this->textures_loaded[pending.textures[j]]);
+			this->meshes.push_back(Mesh(pending.vertices, pending.indices, textures, this->name));
+			uploaded += pending.vertices.size() * sizeof(Vertex) + pending.indices.size() * sizeof(GLuint);
+
+			vector<Vertex>().swap(pending.vertices);
+			vector<GLuint>().swap(pending.indices);
+			tracker.Release(pending.memory);
+			pending.memory = 0;
+		}
+		this->freePending();
+		return this->stepDone(true, uploaded, uploadedBytes);
+	}
+
+	const ModelLoadStats& LoadStats() { return this->stats; }
+
+	//Deletes all meshes and textures on the GPU and CPU (model draws nothing afterwards)
+	void Release()
+	{
+		MemoryTracker::Get().UnregisterEvictable(this->evictable);
+		this->evictable = 0;
+		this->freePending();
+		for (GLuint i = 0; i < this->meshes.size(); i++)
+			this->meshes[i].Release();
+		for (GLuint i = 0; i < this->textures_loaded.size(); i++)
+			glDeleteTextures(1, &this->textures_loaded[i].id);
+		vector<Mesh>().swap(this->meshes);
+		vector<Texture>().swap(this->textures_loaded);
+		MemoryTracker::Get().Release(this->memory);
+	}
+
 private:
+	//Mesh that has been imported but not uploaded yet
+	struct PendingMesh
+	{
+		vector<Vertex> vertices;
+		vector<GLuint> indices;
+		vector<GLuint> textures; //Indices into textures_loaded
+		MemoryHandle memory;
+	};
+
+	//Decoded texture waiting for upload, one for each entry in textures_loaded
+	struct PendingImage
+	{
+		unsigned char* pixels;
+		int width, height;
+		MemoryHandle memory;
+	};
+
 	// Model Data //
 	vector<Mesh> meshes;
 	string directory;
+	string name; //Model's file path, shown as the owner of its allocations (models of the same file share it)
 	vector<Texture> textures_loaded;
+	vector<MemoryHandle> memory; //Tracked textures, released in Release()
+	ModelLoadStats stats;
+	EvictableHandle evictable = 0; //Registration with MemoryTracker, made by Upload
+
+	// Staging Data (filled by Import, emptied by Upload) //
+	vector<PendingMesh> pending_meshes;
+	vector<PendingImage> pending_images;
+	size_t uploaded_images = 0; //How far UploadStep has got
+	size_t uploaded_meshes = 0;
+	const atomic<bool>* cancel = NULL; //Only set while Import runs
+
+	bool cancelled() { return this->cancel && this->cancel->load(); }
+
+	bool stepDone(bool done, size_t uploaded, size_t* uploadedBytes)
+	{
+		if (uploadedBytes)
+			*uploadedBytes = uploaded;
+		return done;
+	}
 
 	// Functions //
-	void loadModel(string path)
+	bool loadModel(string path)
 	{
 		//Loads Model
+		chrono::steady_clock::time_point parseStart = chrono::steady_clock::now();
 		Assimp::Importer importer;
 		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+		chrono::steady_clock::time_point convertStart = chrono::steady_clock::now();
+		this->stats.parseMs = chrono::duration<double, milli>(convertStart - parseStart).count();
 
 		//Error Handling
 		if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
@@ -56,7 +210,7 @@ private:
 		{
 			//Error Report
 			cout << "ERROR::ASSIMP::" << importer.GetErrorString() << endl;
-			return;
+			return false;
 		}
 		//Retrieve the directory path of the filepath
 		this->directory = path.substr(0, path.find_last_of('/'));
@@ -64,8 +218,26 @@ private:
 		//Process Assimp root node recursively (recursive processNode Function)
 		//(Each node possibly contains a set of children to process)
 		this->processNode(scene->mRootNode, scene);
+		this->stats.convertMs = chrono::duration<double, milli>(chrono::steady_clock::now() - convertStart).count();
+		return true;
+	}
 
-
+	//Frees whatever Import staged and Upload hasn't consumed
+	void freePending()
+	{
+		MemoryTracker& tracker = MemoryTracker::Get();
+		for (GLuint i = 0; i < this->pending_meshes.size(); i++)
+			tracker.Release(this->pending_meshes[i].memory);
+		for (GLuint i = 0; i < this->pending_images.size(); i++)
+		{
+			if (this->pending_images[i].pixels)
+				SOIL_free_image_data(this->pending_images[i].pixels);
+			tracker.Release(this->pending_images[i].memory);
+		}
+		vector<PendingMesh>().swap(this->pending_meshes);
+		vector<PendingImage>().swap(this->pending_images);
+		this->uploaded_images = 0;
+		this->uploaded_meshes = 0;
 	}
 
 
@@ -85,10 +257,12 @@ private:
 		//Process all meshes of the nodes
 		for (GLuint i = 0; i < node->mNumMeshes; i++)
 		{
+			if (this->cancelled())
+				return; //Stop early, Import reports the cancel
 			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
 			//Check each of node's mesh indices, retrieve corresponding mesh by indexing mMeshes array
-			this->meshes.push_back(this->processMesh(mesh, scene));
-			//returned mesh passed to processMesh function (which returns a Mesh object to store in Mesh list)
+			this->pending_meshes.push_back(this->processMesh(mesh, scene));
+			//returned mesh passed to processMesh function (which returns a PendingMesh to upload later)
 		}
 
 		//Same for each node's children
@@ -105,14 +279,14 @@ private:
 	2. Retrieve mesh's indices
 	3. Retrieve relevant material data
 
-	Proecssed data is stored in one of 3 vectors. Mesh is created from those and returned.
+	Proecssed data is stored in one of 3 vectors. PendingMesh is created from those and returned, Upload turns it into a Mesh.
 	*/
-	Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+	PendingMesh processMesh(aiMesh* mesh, const aiScene* scene)
 	{
 
 		vector<Vertex> vertices;
 		vector<GLuint> indices;
-		vector<Texture> textures;
+		vector<GLuint> textures;
 
 		for (GLuint i = 0; i < mesh->mNumVertices; i++)
 		{
@@ -127,10 +301,15 @@ private:
 
 
 			// Normals //
-			vector.x = mesh->mNormals[i].x;
-			vector.y = mesh->mNormals[i].y;
-			vector.z = mesh->mNormals[i].z;
-			vertex.Normal = vector;
+			if (mesh->mNormals) //Files without normals (e.g. OBJ without vn lines) leave this NULL
+			{
+				vector.x = mesh->mNormals[i].x;
+				vector.y = mesh->mNormals[i].y;
+				vector.z = mesh->mNormals[i].z;
+				vertex.Normal = vector;
+			}
+			else
+				vertex.Normal = glm::vec3(0.0f, 0.0f, 0.0f);
 
 
 			// Tex Coords //
@@ -182,15 +361,23 @@ private:
 
 
 			//Load mesh's diffuse textures
-			vector<Texture> diffuseMaps = this->loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+			vector<GLuint> diffuseMaps = this->loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
 			textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 
 			//Load mesh's specular textures
-			vector<Texture> specularMaps = this->loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+			vector<GLuint> specularMaps = this->loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
 			textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
 
 		}
-		return Mesh(vertices, indices, textures);
+
+		PendingMesh pending;
+		pending.vertices.swap(vertices);
+		pending.indices.swap(indices);
+		pending.textures.swap(textures);
+		//Staged copies are freed by Upload, Mesh then tracks its own
+		pending.memory = MemoryTracker::Get().Track(this->name, MEMORY_VERTICES, MEMORY_CPU,
+			pending.vertices.capacity() * sizeof(Vertex) + pending.indices.capacity() * sizeof(GLuint));
+		return pending;
 	}
 
 	// Load Material Textures Function //
@@ -198,11 +385,12 @@ private:
 	/*
 	Iterates through the texture locations of given texture type
 	Retrieves texture's file location
-	Loads & generates texture & stores info in a Vertex struct
+	Decodes texture & stores info in a Texture struct
+	Returns indices into textures_loaded (the GL texture is only created in Upload)
 	*/
-	vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+	vector<GLuint> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
 	{
-		vector<Texture> textures;
+		vector<GLuint> textures;
 		for (GLuint i = 0; i < mat->GetTextureCount(type); i++)
 			//Check amount of textures stored in material using GetTextureCount
 		{
@@ -220,7 +408,7 @@ private:
 			{
 				if (textures_loaded[j].path == str)
 				{
-					textures.push_back(textures_loaded[j]);
+					textures.push_back(j);
 					skip = true;
 					break;
 				}
@@ -230,12 +418,14 @@ private:
 			{
 				//If textures haven't been loaded already, then load it
 				Texture texture;
-				texture.id = TextureFromFile(str.C_Str(), this->directory);
-				//TextureFromFile loads a texture (using SOIL) and returns its ID
+				texture.id = 0; //Assigned in Upload
 				texture.type = typeName;
 				texture.path = str;
-				textures.push_back(texture);
+				textures.push_back(this->textures_loaded.size());
 				this->textures_loaded.push_back(texture); //add to loaded textures
+				this->pending_images.push_back(this->loadImage(str.C_Str(), this->directory));
+				//loadImage decodes a texture (using SOIL) for uploadTexture to create it later
+				this->memory.push_back(MemoryTracker::Get().Track(this->name, MEMORY_TEXTURE_INFO, MEMORY_CPU, sizeof(Texture)));
 			}
 
 		}
@@ -244,18 +434,30 @@ private:
 	}
 
 
-	GLint TextureFromFile(const char* path, string directory)
+	//Decodes texture data (no GL calls)
+	PendingImage loadImage(const char* path, string directory)
 	{
-		//Generate texture ID and load texture data 
 		string filename = string(path);
 		filename = directory + '/' + filename;
+		PendingImage image;
+		image.width = 0;
+		image.height = 0;
+		image.pixels = SOIL_load_image(filename.c_str(), &image.width, &image.height, 0, SOIL_LOAD_RGB);
+		if (!image.pixels)
+			cout << "ERROR::SOIL::COULD_NOT_LOAD::" << filename << endl;
+		//Decoded pixels only live until the upload is done, but they still count towards the CPU peak
+		image.memory = MemoryTracker::Get().Track(this->name, MEMORY_TEXTURE_IMAGE, MEMORY_CPU, (size_t)image.width * image.height * 3);
+		return image;
+	}
+
+	//Generates texture ID and uploads decoded data, the image itself is freed later by freePending
+	GLuint uploadTexture(const PendingImage& image)
+	{
 		GLuint textureID;
 		glGenTextures(1, &textureID);
-		int width, height;
-		unsigned char* image = SOIL_load_image(filename.c_str(), &width, &height, 0, SOIL_LOAD_RGB);
 		// Assign texture to ID
 		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.pixels);
 		
 		glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -265,7 +467,8 @@ private:
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glBindTexture(GL_TEXTURE_2D, 0);
-		SOIL_free_image_data(image);
+		//RGB is padded to 4 bytes per texel by drivers, plus the full mipmap chain
+		this->memory.push_back(MemoryTracker::Get().Track(this->name, MEMORY_TEXTURE_IMAGE, MEMORY_GPU, EstimateTextureBytes(image.width, image.height, 4, true)));
 		return textureID;
 	}
 };
\ No newline at end of file
@@ -0,0 +1,449 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Shader.h"
+#include "Model.h"
+
+using namespace std;
+
+// Scene Entry //
+//One placement of a model in the scene
+struct SceneEntry
+{
+	string modelPath;
+	glm::vec3 position;
+	GLfloat scale;
+	GLfloat spin; //Rotation about the y axis in degrees per second
+	bool cancelled;
+};
+
+//Per frame limits for uploads on the main thread
+struct UploadBudget
+{
+	size_t bytes = 4 * 1024 * 1024;
+	double milliseconds = 2.0;
+};
+
+// Scene Loader //
+/*
+Streams a scene of many models in without blocking the render loop.
+
+1. Each distinct model path is imported once (placements of the same file share one Model)
+   by a pool of background threads, closest to the camera first
+2. Update(), called every frame on the GL thread, uploads imported models in small slices
+   (Model::UploadStep) until the frame's byte/time budget is used up, closest first
+3. Once a model's last slice is submitted a fence is inserted, the model becomes visible
+   when the GPU has passed that fence
+4. Only visible models are registered for eviction (farthest from the camera goes first when
+   everything is drawn). An evicted model is released and only goes back to the import queue
+   once nothing else is loading and its old size fits in the budget again, so it doesn't
+   immediately push memory back over the budget
+
+Loads can be cancelled per entry, queued imports are dropped, running ones stop at the next mesh.
+Update, Draw and Cancel must be called from the thread owning the GL context.
+*/
+class SceneLoader
+{
+public:
+	enum AssetState
+	{
+		ASSET_QUEUED,		//Waiting for an import thread
+		ASSET_IMPORTING,	//Being read by an import thread
+		ASSET_IMPORTED,		//In CPU memory, waiting for upload
+		ASSET_UPLOADING,	//Partly uploaded
+		ASSET_FENCED,		//Fully submitted, waiting for the GPU
+		ASSET_READY,		//Visible
+		ASSET_EVICTED,		//Unloaded by a memory budget, re-queued once it fits again
+		ASSET_FAILED,
+		ASSET_CANCELLED
+	};
+
+	//Import threads are started by the first Update, once distances to the camera are known
+	SceneLoader(int importThreads = 2)
+	{
+		this->start = chrono::steady_clock::now();
+		this->importThreads = importThreads > 0 ? importThreads : 1;
+	}
+
+	~SceneLoader()
+	{
+		{
+			lock_guard<mutex> lock(this->assetMutex);
+			this->stopping = true;
+			for (size_t i = 0; i < this->assets.size(); i++)
+			{
+				this->assets[i]->cancel = true; //Running imports bail out early
+				MemoryTracker::Get().UnregisterEvictable(this->assets[i]->evictable); //Callbacks point at this loader
+			}
+		}
+		this->work.notify_all();
+		for (size_t i = 0; i < this->workers.size(); i++)
+			this->workers[i].join();
+		//Models are dropped without Release - the GL context may already be gone
+	}
+
+	/*
+	Reads a scene manifest, one placement per line:
+	model_path x y z [scale] [spin]
+	Empty lines and lines starting with # are skipped.
+	*/
+	bool LoadManifest(const string& path)
+	{
+		ifstream file(path.c_str());
+		if (!file)
+		{
+			cout << "ERROR::SCENE::COULD_NOT_OPEN::" << path << endl;
+			return false;
+		}
+		string line;
+		int lineNumber = 0;
+		while (getline(file, line))
+		{
+			lineNumber++;
+			if (line.empty() || line[0] == '#' || line[0] == '\r')
+				continue;
+			stringstream ss(line);
+			string modelPath;
+			glm::vec3 position;
+			GLfloat scale = 1.0f, spin = 0.0f;
+			if (!(ss >> modelPath >> position.x >> position.y >> position.z))
+			{
+				cout << "ERROR::SCENE::BAD_ENTRY::" << path << ":" << lineNumber << endl;
+				return false;
+			}
+			ss >> scale >> spin; //Optional
+			this->Add(modelPath, position, scale, spin);
+		}
+		return true;
+	}
+
+	//Adds a placement and queues its model for import, returns the entry's index
+	size_t Add(const string& modelPath, glm::vec3 position, GLfloat scale = 1.0f, GLfloat spin = 0.0f)
+	{
+		SceneEntry entry = { modelPath, position, scale, spin, false };
+		lock_guard<mutex> lock(this->assetMutex);
+
+		map<string, Asset*>::iterator it = this->assetsByPath.find(modelPath);
+		Asset* asset;
+		if (it != this->assetsByPath.end() && it->second->state != ASSET_CANCELLED && !it->second->cancel)
+			asset = it->second; //A cancelled import may still be running, it is never reused
+		else
+		{
+			this->assets.push_back(unique_ptr<Asset>(new Asset(modelPath)));
+			asset = this->assets.back().get();
+			this->assetsByPath[modelPath] = asset;
+			this->work.notify_one();
+		}
+		asset->users++;
+		this->entries.push_back(entry);
+		this->entryAssets.push_back(asset);
+		return this->entries.size() - 1;
+	}
+
+	//Stops loading (or unloads) an entry's model once no other entry uses it
+	void Cancel(size_t entry)
+	{
+		shared_ptr<Model> release;
+		{
+			lock_guard<mutex> lock(this->assetMutex);
+			if (entry >= this->entries.size() || this->entries[entry].cancelled)
+				return;
+			this->entries[entry].cancelled = true;
+			Asset* asset = this->entryAssets[entry];
+			if (--asset->users > 0)
+				return;
+
+			asset->cancel = true;
+			if (asset->state == ASSET_IMPORTING)
+				return; //The worker sees the flag and marks it cancelled
+			MemoryTracker::Get().UnregisterEvictable(asset->evictable);
+			asset->evictable = 0;
+			if (asset->state == ASSET_UPLOADING || asset->state == ASSET_FENCED || asset->state == ASSET_READY)
+				release = asset->model; //Already has GL objects
+			if (asset->state == ASSET_READY)
+				this->ready--;
+			if (asset->fence)
+				glDeleteSync(asset->fence);
+			asset->fence = 0;
+			asset->model.reset();
+			asset->state = ASSET_CANCELLED;
+		}
+		if (release)
+			release->Release();
+	}
+
+	//Cancels every entry further than distance from the camera, returns how many were cancelled
+	size_t CancelBeyond(glm::vec3 cameraPos, GLfloat distance)
+	{
+		vector<size_t> far;
+		{
+			lock_guard<mutex> lock(this->assetMutex);
+			for (size_t i = 0; i < this->entries.size(); i++)
+				if (!this->entries[i].cancelled && glm::length(this->entries[i].position - cameraPos) > distance)
+					far.push_back(i);
+		}
+		for (size_t i = 0; i < far.size(); i++)
+			this->Cancel(far[i]);
+		return far.size();
+	}
+
+	/*
+	Call once per frame on the GL thread before Draw.
+	Re-prioritises loads by distance to the camera, spends the upload budget
+	and makes models whose fence has signalled visible.
+	*/
+	void Update(glm::vec3 cameraPos, const UploadBudget& budget)
+	{
+		chrono::steady_clock::time_point sliceStart = chrono::steady_clock::now();
+
+		lock_guard<mutex> lock(this->assetMutex);
+
+		// Priorities //
+		for (size_t i = 0; i < this->assets.size(); i++)
+			this->assets[i]->distance = -1.0f;
+		for (size_t i = 0; i < this->entries.size(); i++)
+		{
+			if (this->entries[i].cancelled)
+				continue;
+			Asset* asset = this->entryAssets[i];
+			GLfloat distance = glm::length(this->entries[i].position - cameraPos);
+			if (asset->distance < 0.0f || distance < asset->distance)
+				asset->distance = distance;
+		}
+
+		// Evicted Models //
+		Asset* evicted = this->closest(ASSET_EVICTED, ASSET_EVICTED);
+		if (evicted && evicted->distance >= 0.0f && !this->loading()
+			&& MemoryTracker::Get().HasRoom(evicted->evictedBytes[MEMORY_CPU], evicted->evictedBytes[MEMORY_GPU]))
+		{
+			evicted->state = ASSET_QUEUED; //One at a time, the next waits until this one is loaded
+			this->work.notify_one();
+		}
+		if (this->workers.empty()) //Only now, otherwise the first imports would go in manifest order
+			for (int i = 0; i < this->importThreads; i++)
+				this->workers.push_back(thread(&SceneLoader::importWorker, this));
+
+		// Fences //
+		for (size_t i = 0; i < this->assets.size(); i++)
+		{
+			Asset& asset = *this->assets[i];
+			if (asset.state != ASSET_FENCED)
+				continue;
+			GLenum status = glClientWaitSync(asset.fence, 0, 0);
+			if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+			{
+				glDeleteSync(asset.fence);
+				asset.fence = 0;
+				asset.state = ASSET_READY; //Visible from now on
+				this->ready++;
+				Asset* evicted = &asset;
+				asset.evictable = MemoryTracker::Get().RegisterEvictable(asset.path, [this, evicted]() { this->evict(evicted); });
+			}
+		}
+
+		// Budgeted Uploads //
+		size_t bytesLeft = budget.bytes;
+		for (;;)
+		{
+			double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - sliceStart).count();
+			if (elapsed >= budget.milliseconds || bytesLeft == 0)
+				break;
+			Asset* next = this->closest(ASSET_IMPORTED, ASSET_UPLOADING);
+			if (!next)
+				break;
+
+			next->state = ASSET_UPLOADING;
+			size_t spent = 0;
+			bool done = next->model->UploadStep(bytesLeft, &spent);
+			bytesLeft = spent >= bytesLeft ? 0 : bytesLeft - spent;
+
+			if (done)
+			{
+				next->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				next->state = ASSET_FENCED;
+			}
+		}
+
+		// Progress //
+		if (!this->reported && this->ready > 0 && this->pendingCount() == 0)
+		{
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - this->start).count();
+			cout << "Scene loaded: " << this->ready << " models in " << seconds << "s" << endl;
+			this->reported = true;
+		}
+	}
+
+	//Draws every entry whose model is ready, expects shader to be in use with view/projection set
+	void Draw(Shader& shader, GLfloat time)
+	{
+		GLint modelLoc = glGetUniformLocation(shader.Program, "model");
+		lock_guard<mutex> lock(this->assetMutex);
+		for (size_t i = 0; i < this->entries.size(); i++)
+		{
+			const SceneEntry& entry = this->entries[i];
+			Asset* asset = this->entryAssets[i];
+			if (entry.cancelled || asset->state != ASSET_READY)
+				continue;
+
+			glm::mat4 model;
+			model = glm::translate(model, entry.position);
+			model = glm::scale(model, glm::vec3(entry.scale, entry.scale, entry.scale));
+			model = glm::rotate(model, glm::radians(entry.spin * time), glm::vec3(0.0f, 1.0f, 0.0f));
+			glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+			MemoryTracker::Get().Touch(asset->evictable, asset->distance);
+			asset->model->Draw(shader);
+		}
+	}
+
+	size_t EntryCount()
+	{
+		lock_guard<mutex> lock(this->assetMutex);
+		return this->entries.size();
+	}
+
+	//Load state of an entry's model, ASSET_CANCELLED once the entry itself is cancelled
+	AssetState EntryState(size_t entry)
+	{
+		lock_guard<mutex> lock(this->assetMutex);
+		if (entry >= this->entries.size() || this->entries[entry].cancelled)
+			return ASSET_CANCELLED;
+		return this->entryAssets[entry]->state;
+	}
+
+private:
+	//One distinct model file, shared by every entry placing it
+	struct Asset
+	{
+		string path;
+		AssetState state = ASSET_QUEUED;
+		shared_ptr<Model> model;
+		GLsync fence = 0;
+		GLfloat distance = -1.0f; //Closest entry to the camera, -1 = not known yet
+		int users = 0;
+		atomic<bool> cancel;
+		EvictableHandle evictable = 0; //Registered while READY
+		size_t evictedBytes[MEMORY_SIDE_COUNT]; //What the model had allocated when it was evicted
+
+		Asset(const string& path) : path(path), cancel(false), evictedBytes() {}
+	};
+
+	vector<SceneEntry> entries;
+	vector<Asset*> entryAssets; //Asset of each entry
+	vector<unique_ptr<Asset> > assets;
+	map<string, Asset*> assetsByPath;
+	mutex assetMutex;
+	condition_variable work;
+	vector<thread> workers;
+	int importThreads;
+	bool stopping = false;
+
+	chrono::steady_clock::time_point start;
+	size_t ready = 0;
+	bool reported = false;
+
+	//Closest asset in either state (unknown distances go last), expects assetMutex to be held
+	Asset* closest(AssetState state, AssetState orState)
+	{
+		Asset* best = NULL;
+		for (size_t i = 0; i < this->assets.size(); i++)
+		{
+			Asset* asset = this->assets[i].get();
+			if (asset->state != state && asset->state != orState)
+				continue;
+			if (!best || (asset->distance >= 0.0f && (best->distance < 0.0f || asset->distance < best->distance)))
+				best = asset;
+		}
+		return best;
+	}
+
+	//Whether any asset is between QUEUED and FENCED, expects assetMutex to be held
+	bool loading()
+	{
+		for (size_t i = 0; i < this->assets.size(); i++)
+			if (this->assets[i]->state <= ASSET_FENCED)
+				return true;
+		return false;
+	}
+
+	//Assets still on their way, expects assetMutex to be held
+	size_t pendingCount()
+	{
+		size_t pending = 0;
+		for (size_t i = 0; i < this->assets.size(); i++)
+		{
+			AssetState state = this->assets[i]->state;
+			if (state != ASSET_READY && state != ASSET_FAILED && state != ASSET_CANCELLED)
+				pending++;
+		}
+		return pending;
+	}
+
+	//Eviction callback from MemoryTracker::EnforceBudgets (GL thread), the registration is already gone
+	void evict(Asset* asset)
+	{
+		shared_ptr<Model> release;
+		{
+			lock_guard<mutex> lock(this->assetMutex);
+			asset->evictable = 0;
+			if (asset->state != ASSET_READY)
+				return;
+			OwnerMemory usage = MemoryTracker::Get().Usage(asset->path);
+			for (int side = 0; side < MEMORY_SIDE_COUNT; side++)
+				asset->evictedBytes[side] = usage.side[side].live;
+			release = asset->model;
+			asset->model.reset();
+			asset->state = ASSET_EVICTED; //Update re-queues it once there is room again
+			this->ready--;
+			this->reported = false;
+		}
+		release->Release();
+	}
+
+	//Import thread - no GL calls
+	void importWorker()
+	{
+		for (;;)
+		{
+			Asset* asset;
+			{
+				unique_lock<mutex> lock(this->assetMutex);
+				this->work.wait(lock, [this]() { return this->stopping || this->closest(ASSET_QUEUED, ASSET_QUEUED); });
+				if (this->stopping)
+					return;
+				asset = this->closest(ASSET_QUEUED, ASSET_QUEUED);
+				asset->state = ASSET_IMPORTING;
+			}
+
+			shared_ptr<Model> model(new Model());
+			bool imported = model->Import(asset->path, &asset->cancel);
+
+			lock_guard<mutex> lock(this->assetMutex);
+			if (asset->cancel)
+				asset->state = ASSET_CANCELLED; //model is dropped, it never touched GL
+			else if (!imported)
+				asset->state = ASSET_FAILED;
+			else
+			{
+				asset->model = model;
+				asset->state = ASSET_IMPORTED;
+			}
+		}
+	}
+};
@@ -8,6 +8,8 @@
 
 #include <GL/glew.h>; //Include glew to get all the required OpenGL headers
 
+#include "MemoryTracker.h"
+
 //Shader Class reads from disk, compiles and links Shaders
 class Shader
 {
@@ -51,6 +53,11 @@ public:
 			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
 		}
 
+		//Sources are freed at the end of the constructor, but still count towards the CPU peak
+		std::string owner = std::string(vertexPath) + "+" + fragmentPath;
+		MemoryTracker& tracker = MemoryTracker::Get();
+		MemoryHandle sources = tracker.Track(owner, MEMORY_SHADER, MEMORY_CPU, vertexCode.capacity() + fragmentCode.capacity());
+
 		const GLchar* vShaderCode = vertexCode.c_str();
 		const GLchar* fShaderCode = fragmentCode.c_str();
 
@@ -102,6 +109,13 @@ public:
 		//Deletes vertex & fragment shaders now they're linked to Shader Program
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
+
+		//Size of the linked program if the driver can tell us, otherwise just count it
+		GLint programBytes = 0;
+		if (GLEW_ARB_get_program_binary)
+			glGetProgramiv(this->Program, GL_PROGRAM_BINARY_LENGTH, &programBytes);
+		tracker.Track(owner, MEMORY_SHADER, MEMORY_GPU, (size_t)programBytes);
+		tracker.Release(sources);
 	}
 	//Use the program
 	void Use() { glUseProgram(this->Program); }
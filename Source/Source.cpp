@@ -14,10 +14,14 @@
 // Other includes //
 #include "Shader.h"
 #include "Model.h"
+#include "BatchRenderer.h"
+#include "SceneLoader.h"
 
 //Function Prototypes
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
 void do_movement();
+bool parse_args(int argc, char* argv[], std::string& scenePath, std::string& jobsPath, BatchSettings& settings);
+bool parse_megabytes(const char* text, size_t& bytes);
 //Dimension of Window
 const GLuint WIDTH = 800, HEIGHT = 600;
 
@@ -31,6 +35,9 @@ glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
 glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
 bool keys[1024];
 
+//Holding C cancels every scene entry further than this from the camera
+const GLfloat CANCEL_DISTANCE = 20.0f;
+
 /*
 //Camera
 glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
@@ -50,15 +57,24 @@ glm::vec3 cameraUp = glm::cross(cameraDirection, cameraRight); //y axis vector
 
 */
 
-int main()
+int main(int argc, char* argv[])
 // Instantiate the GLFW Window //
 
 {
+	//Batch mode renders turntables of the models in a job list to image files instead of opening a window
+	std::string sceneManifest;
+	std::string batchJobs;
+	BatchSettings batchSettings;
+	if (!parse_args(argc, argv, sceneManifest, batchJobs, batchSettings))
+		return -1;
+	bool batch = !batchJobs.empty();
+
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); //What options we want to configure
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3); //Integer that sets value of our option
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); //Using Core Profile of OpenGL instead of Immediate Mode
 	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+	glfwWindowHint(GLFW_VISIBLE, batch ? GL_FALSE : GL_TRUE); //Batch mode only needs the context
 
 	/* GLFW's Create Window function. Arg 1, 2 = Width, Height. Arg 3 = Window name
 	nullptr = ignore */
@@ -88,7 +104,33 @@ int main()
 							 // Build and compile the shader program //
 	//Shader ourShader("D:/Documents/Visual Studio 2015/Projects/newEPQ/newEPQ/vertex.txt", "D:/Documents/Visual Studio 2015/Projects/newEPQ/newEPQ/fragment.txt");
 	Shader ourShader("vertex.txt", "fragment.txt");
-	Model ourModel("monkey/monkey.obj");
+
+	if (batch)
+	{
+		vector<TurntableJob> jobs;
+		int written = 0;
+		if (LoadTurntableJobs(batchJobs, jobs))
+		{
+			BatchRenderer renderer(batchSettings, ourShader);
+			written = renderer.Run(jobs);
+		}
+		glfwTerminate();
+		return written > 0 ? 0 : -1;
+	}
+
+	//Models are imported on background threads and appear once they're uploaded
+	SceneLoader scene;
+	UploadBudget uploadBudget; //How much uploading each frame may do
+	if (!sceneManifest.empty())
+	{
+		if (!scene.LoadManifest(sceneManifest))
+		{
+			glfwTerminate();
+			return -1;
+		}
+	}
+	else
+		scene.Add("monkey/monkey.obj", glm::vec3(0.0f, 0.0f, 0.0f), 0.5f, glm::degrees(1.0f)); //Spins 1 radian per second
 
 	//Model ourModel("nanosuit/nanosuit.obj");
 	//Model ourModel("D:/Documents/Visual Studio 2015/Projects/newEPQ/newEPQ/monkey/monkey.obj");
@@ -109,11 +151,21 @@ int main()
 		glfwPollEvents(); //checks if any events are triggered (e.g. mouse input)
 		do_movement();
 
+		if (keys[GLFW_KEY_C])
+		{
+			size_t cancelled = scene.CancelBeyond(cameraPos, CANCEL_DISTANCE);
+			if (cancelled > 0)
+				std::cout << "Cancelled " << cancelled << " scene entries" << std::endl;
+		}
+
 		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);  //This colour fills the screen whenever buffer is cleared
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //clear screen's colour buffer
 
 
 
+		//Stream in more of the scene, closest models first
+		scene.Update(cameraPos, uploadBudget);
+
 		// Draw Shape //
 		ourShader.Use();
 
@@ -138,16 +190,6 @@ int main()
 		*/
 
 
-		glm::mat4 model;
-		model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // Translate it down a bit so it's at the center of the scene
-		model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5));	// It's a bit too big for our scene, so scale it down
-		//model = glm::translate(model, glm::vec3(0.0f, -1.75f, 0.0f));
-		//model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));
-		model = glm::rotate(model, GLfloat(glfwGetTime()), glm::vec3(0.0f, 1.0f, 0.0f));
-		glUniformMatrix4fv(glGetUniformLocation(ourShader.Program, "model"), 1, GL_FALSE, glm::value_ptr(model));
-		ourModel.Draw(ourShader);
-
-
 		// Find Matrix Uniform location and set matrix //
 		GLuint modelLoc = glGetUniformLocation(ourShader.Program, "model");
 		GLuint viewLoc = glGetUniformLocation(ourShader.Program, "view");
@@ -164,6 +206,9 @@ int main()
 		4. actual matrix data stored in the form of value_ptr
 		*/
 
+		// Draw Scene //
+		scene.Draw(ourShader, GLfloat(glfwGetTime())); //Sets each model's "model" matrix itself
+
 
 		
 		
@@ -172,6 +217,9 @@ int main()
 		glBindVertexArray(0);
 
 		glfwSwapBuffers(window); //display the other Color buffer as an output
+
+		//Unload least recently drawn models if an evicting memory budget was exceeded
+		MemoryTracker::Get().EnforceBudgets();
 	}
 	//glDeleteVertexArrays(1, &VAO);
 	//glDeleteBuffers(1, &VBO);
@@ -188,6 +236,9 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) //when user presses escape key, WindowShouldClose = true
 		glfwSetWindowShouldClose(window, GL_TRUE);
 
+	if (key == GLFW_KEY_M && action == GLFW_PRESS) //M dumps current memory usage
+		MemoryTracker::Get().DumpJSON(std::string("memory.json"));
+
 	if (action == GLFW_PRESS)
 		keys[key] = true;
 	else if (action == GLFW_RELEASE)
@@ -211,3 +262,89 @@ void do_movement()
 	
 
 }
+
+
+
+// Command Line Arguments //
+/*
+EPQ [--scene scene.txt] [--cpu-budget MB] [--gpu-budget MB] [--evict]
+EPQ --batch jobs.txt [--size 512x512] [--out directory] [--format png|exr] [--threads 4] [--buffers 3]
+No arguments = interactive viewer showing the monkey. Returns false if the arguments are wrong.
+Budgets are applied to MemoryTracker here, over budget warns (or unloads models with --evict).
+*/
+bool parse_args(int argc, char* argv[], std::string& scenePath, std::string& jobsPath, BatchSettings& settings)
+{
+	size_t cpuBudget = 0, gpuBudget = 0; //0 = unlimited
+	MemoryBudgetPolicy budgetPolicy = BUDGET_WARN;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--scene" && hasValue)
+			scenePath = argv[++i];
+		else if (arg == "--batch" && hasValue)
+			jobsPath = argv[++i];
+		else if (arg == "--size" && hasValue)
+		{
+			std::stringstream size(argv[++i]);
+			char x = 0;
+			size >> settings.width >> x >> settings.height;
+			if (size.fail() || x != 'x' || settings.width <= 0 || settings.height <= 0)
+			{
+				std::cout << "ERROR::ARGS::BAD_SIZE::" << argv[i] << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--out" && hasValue)
+			settings.outputDir = argv[++i];
+		else if (arg == "--format" && hasValue)
+		{
+			settings.format = argv[++i];
+			if (settings.format != "png" && settings.format != "exr")
+			{
+				std::cout << "ERROR::ARGS::BAD_FORMAT::" << settings.format << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--threads" && hasValue)
+			settings.encoderThreads = atoi(argv[++i]);
+		else if (arg == "--buffers" && hasValue)
+			settings.readbackBuffers = atoi(argv[++i]);
+		else if ((arg == "--cpu-budget" || arg == "--gpu-budget") && hasValue)
+		{
+			//Memory budgets in megabytes, only warn unless --evict is given as well
+			if (!parse_megabytes(argv[++i], arg == "--cpu-budget" ? cpuBudget : gpuBudget))
+			{
+				std::cout << "ERROR::ARGS::BAD_BUDGET::" << argv[i] << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--evict")
+			budgetPolicy = BUDGET_EVICT;
+		else
+		{
+			std::cout << "ERROR::ARGS::UNKNOWN::" << arg << std::endl;
+			std::cout << "Usage: EPQ [--scene scene.txt] [--cpu-budget MB] [--gpu-budget MB] [--evict]" << std::endl;
+			std::cout << "       EPQ --batch jobs.txt [--size 512x512] [--out directory] [--format png|exr] [--threads 4] [--buffers 3]" << std::endl;
+			return false;
+		}
+	}
+
+	MemoryTracker& tracker = MemoryTracker::Get();
+	tracker.SetBudget(MEMORY_CPU, cpuBudget, budgetPolicy);
+	tracker.SetBudget(MEMORY_GPU, gpuBudget, budgetPolicy);
+	return true;
+}
+
+//Reads a positive number of megabytes (fractions allowed)
+bool parse_megabytes(const char* text, size_t& bytes)
+{
+	std::stringstream ss(text);
+	double megabytes = 0.0;
+	ss >> megabytes;
+	if (ss.fail() || megabytes <= 0.0)
+		return false;
+	bytes = (size_t)(megabytes * 1024.0 * 1024.0);
+	return true;
+}